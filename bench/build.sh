@@ -0,0 +1,3 @@
+#!/bin/bash
+gcc hash_bench.c -I.. -O2 -o hash_bench -lm
+gcc trie_bench.c -I.. -O2 -o trie_bench
@@ -0,0 +1,252 @@
+// Compares the hash functions in stli/hash.h and the ones the hash trie and JSON objects used to have.
+// Reports throughput per key length, collisions and bucket spread on realistic key sets, avalanche behaviour and how
+// deep a hash trie gets with each of them.
+// ./build.sh && ./hash_bench
+#include "keys.h"
+#include <stli/hash.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <math.h>
+
+typedef struct
+{
+	const char *name;
+	uint64_t (*fn)(const char *s, size_t n);
+	int bits; // Width of the output, narrower hashes are in the low bits
+} HashFunc;
+
+// The multiply-xor loop hash_trie_hash_func_ and json_hash64 used before hash64
+static uint64_t legacy_hash(const char *s, size_t n)
+{
+	uint64_t h = 0x100;
+	for(size_t i = 0; i < n; i++)
+	{
+		h ^= s[i];
+		h *= 1111111111111111111u;
+	}
+	return h;
+}
+static uint64_t fnv1a_32_(const char *s, size_t n)
+{
+	return fnv1a_32(s);
+}
+static uint64_t fnv1a_64_(const char *s, size_t n)
+{
+	return fnv1a_64(s);
+}
+static uint64_t fnv1a_64_range_(const char *s, size_t n)
+{
+	return fnv1a_64_range(s, s + n);
+}
+static uint64_t hash64_(const char *s, size_t n)
+{
+	return hash64(s, n);
+}
+static uint64_t hash64_lc_(const char *s, size_t n)
+{
+	return hash64_lc(s, n);
+}
+
+static const HashFunc hash_funcs[] = {
+	{"fnv1a_32", fnv1a_32_, 32},
+	{"fnv1a_64", fnv1a_64_, 64},
+	{"fnv1a_64_range", fnv1a_64_range_, 64},
+	{"legacy", legacy_hash, 64},
+	{"hash64", hash64_, 64},
+	{"hash64_lc", hash64_lc_, 64},
+	{NULL, NULL, 0}
+};
+
+static void bench_throughput(void)
+{
+	static const size_t lengths[] = { 1, 4, 8, 16, 24, 32, 64, 256, 4096 };
+	char *buf = malloc(1 << 20);
+	for(size_t i = 0; i < (1 << 20); ++i)
+		buf[i] = 'a' + rng() % 26;
+	buf[(1 << 20) - 1] = 0;
+
+	printf("throughput (ns/key, MB/s)\n%-16s", "length");
+	for(size_t l = 0; l < sizeof(lengths) / sizeof(lengths[0]); ++l)
+		printf("%16zu", lengths[l]);
+	printf("\n");
+	uint64_t sink = 0;
+	for(const HashFunc *hf = hash_funcs; hf->name; ++hf)
+	{
+		printf("%-16s", hf->name);
+		for(size_t l = 0; l < sizeof(lengths) / sizeof(lengths[0]); ++l)
+		{
+			size_t len = lengths[l];
+			size_t iterations = (64 << 20) / (len + 16);
+			// fnv1a_32/64 stop at the terminator, so cut the strings up in place
+			char saved[64];
+			size_t stride = len + 1;
+			size_t nkeys = ((1 << 20) - 1) / stride;
+			if(nkeys > 64)
+				nkeys = 64;
+			for(size_t k = 0; k < nkeys; ++k)
+			{
+				saved[k] = buf[k * stride + len];
+				buf[k * stride + len] = 0;
+			}
+			double t0 = now();
+			for(size_t i = 0; i < iterations; ++i)
+				sink += hf->fn(buf + (i % nkeys) * stride, len);
+			double t1 = now();
+			for(size_t k = 0; k < nkeys; ++k)
+				buf[k * stride + len] = saved[k];
+			double ns = (t1 - t0) * 1e9 / iterations;
+			char cell[32];
+			snprintf(cell, sizeof(cell), "%.1f %.0f", ns, len / ns * 1e3);
+			printf("%16s", cell);
+		}
+		printf("\n");
+	}
+	printf("(%llx)\n\n", (unsigned long long)(sink & 0xf));
+	free(buf);
+}
+
+static int cmp_u64(const void *a, const void *b)
+{
+	uint64_t x = *(const uint64_t *)a, y = *(const uint64_t *)b;
+	return x < y ? -1 : x > y;
+}
+
+static size_t count_collisions(uint64_t *h, size_t n)
+{
+	qsort(h, n, sizeof(uint64_t), cmp_u64);
+	size_t c = 0;
+	for(size_t i = 1; i < n; ++i)
+		c += h[i] == h[i - 1];
+	return c;
+}
+
+// Depth every key ends up at in a hash trie, same descent as hash_trie_upsert
+typedef struct
+{
+	uint32_t child[1 << HASH_TRIE_ARY];
+} SimNode;
+
+static void trie_depth(const uint64_t *hashes, size_t n, double *mean, size_t *max)
+{
+	SimNode *nodes = calloc(n + 1, sizeof(SimNode));
+	size_t used = 0;
+	size_t total = 0;
+	*max = 0;
+	uint32_t root = 0;
+	for(size_t i = 0; i < n; ++i)
+	{
+		uint32_t *m = &root;
+		size_t depth = 0;
+		for(uint64_t h = hashes[i]; *m; h <<= HASH_TRIE_ARY, ++depth)
+			m = &nodes[*m].child[h >> (64 - HASH_TRIE_ARY)];
+		*m = ++used;
+		total += depth;
+		if(depth > *max)
+			*max = depth;
+	}
+	*mean = n ? (double)total / n : 0;
+	free(nodes);
+}
+
+static void bench_quality(KeySet *ks)
+{
+	printf("%s (%zu keys)\n", ks->name, ks->count);
+	printf("%-16s%12s%12s%12s%12s%12s\n", "hash", "coll64", "coll32", "chi2/10bit", "mean depth", "max depth");
+	uint64_t *h = malloc(ks->count * sizeof(uint64_t));
+	uint64_t *tmp = malloc(ks->count * sizeof(uint64_t));
+	enum { BUCKET_BITS = 10, BUCKETS = 1 << BUCKET_BITS };
+	for(const HashFunc *hf = hash_funcs; hf->name; ++hf)
+	{
+		for(size_t i = 0; i < ks->count; ++i)
+			h[i] = hf->fn(ks->keys[i], ks->lengths[i]);
+		if(hf->bits < 64)
+		{
+			// Move the bits to the top where the trie and bucket test look
+			for(size_t i = 0; i < ks->count; ++i)
+				h[i] <<= 64 - hf->bits;
+		}
+
+		// Chi-squared over the top bits, ~BUCKETS - 1 is a good spread
+		size_t buckets[BUCKETS] = { 0 };
+		for(size_t i = 0; i < ks->count; ++i)
+			buckets[h[i] >> (64 - BUCKET_BITS)]++;
+		double expected = (double)ks->count / BUCKETS;
+		double chi2 = 0;
+		for(size_t b = 0; b < BUCKETS; ++b)
+			chi2 += (buckets[b] - expected) * (buckets[b] - expected) / expected;
+
+		double mean;
+		size_t max;
+		trie_depth(h, ks->count, &mean, &max);
+
+		memcpy(tmp, h, ks->count * sizeof(uint64_t));
+		size_t c64 = count_collisions(tmp, ks->count);
+		for(size_t i = 0; i < ks->count; ++i)
+			tmp[i] = h[i] >> 32;
+		size_t c32 = count_collisions(tmp, ks->count);
+		printf("%-16s%12zu%12zu%12.0f%12.2f%12zu\n", hf->name, c64, c32, chi2, mean, max);
+	}
+	printf("\n");
+	free(h);
+	free(tmp);
+}
+
+// Flips every input bit of random keys and measures how often each output bit changes, ideally half the time.
+static void bench_avalanche(size_t key_length)
+{
+	enum { SAMPLES = 2000 };
+	printf("avalanche, %zu byte keys (worst output bit bias, mean bits flipped, output bits)\n", key_length);
+	char key[64];
+	for(const HashFunc *hf = hash_funcs; hf->name; ++hf)
+	{
+		size_t flips[64] = { 0 };
+		size_t total = 0;
+		size_t trials = 0;
+		for(size_t s = 0; s < SAMPLES; ++s)
+		{
+			// Stay clear of 0 bytes since some of the functions stop there
+			for(size_t i = 0; i < key_length; ++i)
+				key[i] = 1 + rng() % 127;
+			key[key_length] = 0;
+			uint64_t base = hf->fn(key, key_length);
+			for(size_t bit = 0; bit < key_length * 8; ++bit)
+			{
+				key[bit / 8] ^= 1 << (bit % 8);
+				if(key[bit / 8])
+				{
+					uint64_t d = base ^ hf->fn(key, key_length);
+					for(int k = 0; k < hf->bits; ++k)
+						flips[k] += (d >> k) & 1;
+					total += __builtin_popcountll(d);
+					trials++;
+				}
+				key[bit / 8] ^= 1 << (bit % 8);
+			}
+		}
+		// Only the bits the function outputs, the ones above never flip
+		double worst = 0;
+		for(int k = 0; k < hf->bits; ++k)
+		{
+			double bias = fabs((double)flips[k] / trials - 0.5);
+			if(bias > worst)
+				worst = bias;
+		}
+		printf("%-16s%12.3f%12.2f%12d\n", hf->name, worst, (double)total / trials, hf->bits);
+	}
+	printf("\n");
+}
+
+int main(int argc, char **argv)
+{
+	size_t count = argc > 1 ? strtoull(argv[1], NULL, 10) : 100000;
+	bench_throughput();
+	KeySet sets[] = { make_identifiers(count), make_json_keys(count), make_array_indices(count) };
+	for(size_t i = 0; i < sizeof(sets) / sizeof(sets[0]); ++i)
+		bench_quality(&sets[i]);
+	bench_avalanche(8);
+	bench_avalanche(32);
+	return 0;
+}
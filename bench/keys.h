@@ -0,0 +1,112 @@
+#pragma once
+// Key sets shared by the benchmarks, modelled on what the hash trie and JSON objects see in practice.
+#define ALLOCATOR_MALLOC_WRAPPER
+#include <stli/hash_trie.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+typedef struct
+{
+	const char *name;
+	char **keys;
+	size_t *lengths;
+	size_t count;
+} KeySet;
+
+static uint64_t rng_state = 0x9e3779b97f4a7c15;
+static uint64_t rng(void)
+{
+	// splitmix64
+	uint64_t z = (rng_state += 0x9e3779b97f4a7c15);
+	z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9;
+	z = (z ^ (z >> 27)) * 0x94d049bb133111eb;
+	return z ^ (z >> 31);
+}
+
+static double now(void)
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+static void key_set_add(KeySet *ks, const char *key)
+{
+	ks->keys = realloc(ks->keys, (ks->count + 1) * sizeof(char *));
+	ks->lengths = realloc(ks->lengths, (ks->count + 1) * sizeof(size_t));
+	ks->keys[ks->count] = strdup(key);
+	ks->lengths[ks->count] = strlen(key);
+	ks->count++;
+}
+
+// C-like identifiers made from common words, e.g. m_playerPosition, max_entity_count_3
+static KeySet make_identifiers(size_t count)
+{
+	static const char *words[] = { "player", "entity", "pos", "position", "count", "max", "min", "id", "index", "name",
+								   "buffer", "size", "length", "data", "node", "next", "prev", "flags", "type", "value",
+								   "width", "height", "x", "y", "z", "velocity", "state", "handle", "asset", "map" };
+	size_t nwords = sizeof(words) / sizeof(words[0]);
+	KeySet ks = { "identifiers" };
+	HashTrie seen;
+	hash_trie_init(&seen);
+	char key[256];
+	while(ks.count < count)
+	{
+		size_t n = 0;
+		size_t parts = 1 + rng() % 4;
+		if(rng() % 4 == 0)
+			n += snprintf(key + n, sizeof(key) - n, "m_");
+		for(size_t i = 0; i < parts; ++i)
+		{
+			const char *w = words[rng() % nwords];
+			if(i > 0 && rng() % 2)
+				n += snprintf(key + n, sizeof(key) - n, "%c%s", w[0] - 'a' + 'A', w + 1);
+			else
+				n += snprintf(key + n, sizeof(key) - n, "%s%s", i > 0 ? "_" : "", w);
+		}
+		if(rng() % 3 == 0)
+			snprintf(key + n, sizeof(key) - n, "%d", (int)(rng() % 100));
+		if(hash_trie_upsert(&seen, key, NULL, true))
+			continue;
+		hash_trie_upsert(&seen, key, &malloc_allocator, true);
+		key_set_add(&ks, key);
+	}
+	return ks;
+}
+
+// Keys as found in Tiled maps and other JSON documents
+static KeySet make_json_keys(size_t count)
+{
+	static const char *keys[] = { "compressionlevel", "height", "width", "infinite", "layers", "data", "id", "name",
+								  "opacity", "type", "visible", "x", "y", "nextlayerid", "nextobjectid", "orientation",
+								  "renderorder", "tiledversion", "tileheight", "tilewidth", "tilesets", "firstgid",
+								  "source", "version", "properties", "value", "objects", "rotation", "gid", "class" };
+	size_t nkeys = sizeof(keys) / sizeof(keys[0]);
+	KeySet ks = { "json keys" };
+	char key[256];
+	for(size_t i = 0; i < count; ++i)
+	{
+		if(i < nkeys)
+			snprintf(key, sizeof(key), "%s", keys[i]);
+		else
+			snprintf(key, sizeof(key), "%s_%zu", keys[i % nkeys], i / nkeys);
+		key_set_add(&ks, key);
+	}
+	return ks;
+}
+
+// How json.c names array elements
+static KeySet make_array_indices(size_t count)
+{
+	KeySet ks = { "array indices" };
+	char key[32];
+	for(size_t i = 0; i < count; ++i)
+	{
+		snprintf(key, sizeof(key), "%zu", i);
+		key_set_add(&ks, key);
+	}
+	return ks;
+}
@@ -0,0 +1,204 @@
+// Compares typed hash tries from stli/hash_trie_template.h with arity 2, 3 and 4 against the generic HashTrie and a
+// frozen copy of it.
+// Reports insert, hit and miss lookup time, how deep keys end up and the memory used per key.
+// ./build.sh && ./trie_bench
+#include "keys.h"
+#include <stli/arena.h>
+#include <stli/hash_trie_template.h>
+#include <stli/hash_trie_frozen.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+HASH_TRIE_DEFINE_CS(Trie2, int, 2)
+HASH_TRIE_DEFINE_CS(Trie3, int, 3)
+HASH_TRIE_DEFINE_CS(Trie4, int, 4)
+
+typedef struct
+{
+	double insert, hit, miss; // ns per key
+	double mean_depth;
+	size_t max_depth;
+	size_t bytes; // Arena bytes used, nodes and keys
+} TrieResult;
+
+static size_t arena_used(Arena *a)
+{
+	size_t used = 0;
+	for(ArenaBlock *block = a->block; block; block = block->prev)
+		used += block->end - (char *)(block + 1);
+	return used - (a->end - a->beg);
+}
+
+// Walks every node of a trie from the root and records how deep it sits.
+#define TRIE_DEPTH(NODE, TRIE, ARY, COUNT, R)                                                                         \
+	do                                                                                                                \
+	{                                                                                                                 \
+		size_t total = 0;                                                                                             \
+		for(NODE *it = (TRIE)->head; it; it = it->next)                                                               \
+		{                                                                                                             \
+			size_t depth = 0;                                                                                         \
+			NODE *m = (TRIE)->root;                                                                                   \
+			for(uint64_t h = it->hash; m != it; h <<= (ARY), ++depth)                                                 \
+				m = m->child[h >> (64 - (ARY))];                                                                      \
+			total += depth;                                                                                           \
+			if(depth > (R)->max_depth)                                                                                \
+				(R)->max_depth = depth;                                                                               \
+		}                                                                                                             \
+		(R)->mean_depth = (double)total / (COUNT);                                                                    \
+	} while(0)
+
+// Runs the same measurements for every variant, hashing is included in every timing. Each variant provides
+// NAME_bench_build (timed as insert, the key's index is the value), NAME_bench_find (the value or -1),
+// NAME_bench_stats (depth and bytes) and NAME_bench_release, all called directly so they can be inlined.
+#define TRIE_BENCH(NAME, TYPE)                                                                                        \
+	static TrieResult bench_##NAME(KeySet *ks, KeySet *misses)                                                        \
+	{                                                                                                                 \
+		TrieResult r = { 0 };                                                                                         \
+		Arena arena;                                                                                                  \
+		arena_init_chained(&arena, &malloc_allocator, 1 << 20, 1);                                                    \
+		Allocator a = arena_allocator(&arena);                                                                        \
+		TYPE t;                                                                                                       \
+		double t0 = now();                                                                                            \
+		NAME##_bench_build(&t, ks, &a);                                                                               \
+		double t1 = now();                                                                                            \
+		long long sink = 0;                                                                                           \
+		for(size_t i = 0; i < ks->count; ++i)                                                                         \
+			sink += NAME##_bench_find(&t, ks->keys[i], ks->lengths[i]);                                               \
+		double t2 = now();                                                                                            \
+		for(size_t i = 0; i < misses->count; ++i)                                                                     \
+			sink += NAME##_bench_find(&t, misses->keys[i], misses->lengths[i]) != -1;                                 \
+		double t3 = now();                                                                                            \
+		if(sink != (long long)ks->count * (ks->count - 1) / 2)                                                        \
+			printf("%s: lookup mismatch\n", #NAME);                                                                   \
+		r.insert = (t1 - t0) * 1e9 / ks->count;                                                                       \
+		r.hit = (t2 - t1) * 1e9 / ks->count;                                                                          \
+		r.miss = (t3 - t2) * 1e9 / misses->count;                                                                     \
+		NAME##_bench_stats(&t, ks, &arena, &r);                                                                       \
+		NAME##_bench_release(&t);                                                                                     \
+		arena_release(&arena);                                                                                        \
+		return r;                                                                                                     \
+	}
+
+// Bench functions for a trie generated by HASH_TRIE_DEFINE
+#define TRIE_BENCH_TEMPLATE(NAME, ARY)                                                                                \
+	static void NAME##_bench_build(NAME *trie, KeySet *ks, Allocator *a)                                              \
+	{                                                                                                                 \
+		NAME##_init(trie);                                                                                            \
+		for(size_t i = 0; i < ks->count; ++i)                                                                         \
+		{                                                                                                             \
+			const char *k = ks->keys[i];                                                                              \
+			size_t n = ks->lengths[i];                                                                                \
+			NAME##_upsert_n(trie, k, n, NAME##_hash(k, n), a)->value = (int)i;                                        \
+		}                                                                                                             \
+	}                                                                                                                 \
+	static long long NAME##_bench_find(NAME *trie, const char *k, size_t n)                                           \
+	{                                                                                                                 \
+		NAME##Node *node = NAME##_upsert_n(trie, k, n, NAME##_hash(k, n), NULL);                                      \
+		return node ? node->value : -1;                                                                               \
+	}                                                                                                                 \
+	static void NAME##_bench_stats(NAME *trie, KeySet *ks, Arena *arena, TrieResult *r)                               \
+	{                                                                                                                 \
+		TRIE_DEPTH(NAME##Node, trie, ARY, ks->count, r);                                                              \
+		r->bytes = arena_used(arena);                                                                                 \
+	}                                                                                                                 \
+	static void NAME##_bench_release(NAME *trie)                                                                      \
+	{                                                                                                                 \
+	}                                                                                                                 \
+	TRIE_BENCH(NAME, NAME)
+
+TRIE_BENCH_TEMPLATE(Trie2, 2)
+TRIE_BENCH_TEMPLATE(Trie3, 3)
+TRIE_BENCH_TEMPLATE(Trie4, 4)
+
+// The generic trie with its runtime case_sensitive flag and the value behind a void *, stored as an integer here
+static void HashTrie_bench_build(HashTrie *trie, KeySet *ks, Allocator *a)
+{
+	hash_trie_init(trie);
+	for(size_t i = 0; i < ks->count; ++i)
+	{
+		const char *k = ks->keys[i];
+		size_t n = ks->lengths[i];
+		hash_trie_upsert_n(trie, k, n, hash_trie_hash(k, n, true), a, true)->value = (void *)(uintptr_t)i;
+	}
+}
+static long long HashTrie_bench_find(HashTrie *trie, const char *k, size_t n)
+{
+	HashTrieNode *node = hash_trie_upsert_n(trie, k, n, hash_trie_hash(k, n, true), NULL, true);
+	return node ? (long long)(uintptr_t)node->value : -1;
+}
+static void HashTrie_bench_stats(HashTrie *trie, KeySet *ks, Arena *arena, TrieResult *r)
+{
+	TRIE_DEPTH(HashTrieNode, trie, HASH_TRIE_ARY, ks->count, r);
+	r->bytes = arena_used(arena);
+}
+static void HashTrie_bench_release(HashTrie *trie)
+{
+}
+TRIE_BENCH(HashTrie, HashTrie)
+
+// Lookups only, insert is the time it takes to build the HashTrie and freeze it
+static void Frozen_bench_build(FrozenHashTrie *ft, KeySet *ks, Allocator *a)
+{
+	HashTrie trie;
+	HashTrie_bench_build(&trie, ks, a);
+	hash_trie_freeze(ft, &trie, &malloc_allocator);
+}
+static long long Frozen_bench_find(FrozenHashTrie *ft, const char *k, size_t n)
+{
+	FrozenHashTrieEntry *e = frozen_hash_trie_lookup_n(ft, k, n, hash_trie_hash(k, n, true), true);
+	return e ? (long long)(uintptr_t)e->value : -1;
+}
+static void Frozen_bench_stats(FrozenHashTrie *ft, KeySet *ks, Arena *arena, TrieResult *r)
+{
+	// Only what the frozen copy takes, the trie it was built from can be thrown away
+	r->bytes = (ft->mask + 1) * sizeof(FrozenHashTrieSlot) + ft->count * sizeof(FrozenHashTrieEntry);
+	for(size_t i = 0; i < ft->count; ++i)
+		r->bytes += ft->entries[i].length + 1;
+}
+static void Frozen_bench_release(FrozenHashTrie *ft)
+{
+	frozen_hash_trie_free(ft, &malloc_allocator);
+}
+TRIE_BENCH(Frozen, FrozenHashTrie)
+
+// Same keys with a suffix none of the sets produce
+static KeySet make_misses(KeySet *ks)
+{
+	KeySet misses = { "misses" };
+	char key[300];
+	for(size_t i = 0; i < ks->count; ++i)
+	{
+		snprintf(key, sizeof(key), "%s#", ks->keys[i]);
+		key_set_add(&misses, key);
+	}
+	return misses;
+}
+
+static void print_result(const char *name, size_t node_size, TrieResult r, size_t count)
+{
+	printf("%-16s%12zu%12.1f%12.1f%12.1f%12.2f%12zu%12.1f\n", name, node_size, r.insert, r.hit, r.miss, r.mean_depth,
+		   r.max_depth, (double)r.bytes / count);
+}
+
+int main(int argc, char **argv)
+{
+	size_t count = argc > 1 ? strtoull(argv[1], NULL, 10) : 100000;
+	KeySet sets[] = { make_identifiers(count), make_json_keys(count), make_array_indices(count) };
+	for(size_t i = 0; i < sizeof(sets) / sizeof(sets[0]); ++i)
+	{
+		KeySet *ks = &sets[i];
+		KeySet misses = make_misses(ks);
+		printf("%s (%zu keys)\n", ks->name, ks->count);
+		printf("%-16s%12s%12s%12s%12s%12s%12s%12s\n", "trie", "node size", "insert ns", "hit ns", "miss ns",
+			   "mean depth", "max depth", "bytes/key");
+		print_result("HashTrie", sizeof(HashTrieNode), bench_HashTrie(ks, &misses), ks->count);
+		print_result("Trie2", sizeof(Trie2Node), bench_Trie2(ks, &misses), ks->count);
+		print_result("Trie3", sizeof(Trie3Node), bench_Trie3(ks, &misses), ks->count);
+		print_result("Trie4", sizeof(Trie4Node), bench_Trie4(ks, &misses), ks->count);
+		print_result("Frozen", sizeof(FrozenHashTrieEntry), bench_Frozen(ks, &misses), ks->count);
+		printf("\n");
+	}
+	return 0;
+}
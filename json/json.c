@@ -2,16 +2,11 @@
 #include <string.h>
 #include <stdlib.h>
 #include "json.h"
+#include <stli/hash.h>
 
 uint64_t json_hash64(JsonString s)
 {
-	uint64_t h = 0x100;
-	for(size_t i = 0; i < s.length; i++)
-	{
-		h ^= s.data[i];
-		h *= 1111111111111111111u;
-	}
-	return h ^ h >> 32;
+	return hash_bytes(s.data, s.length);
 }
 static JsonString json_string_dup(JsonString str, JsonAllocatorFn allocator)
 {
@@ -56,6 +51,33 @@ JsonObjectEntry *json_object_upsert(JsonObject *map, JsonString key, JsonAllocat
 	return NULL;
 }
 
+static void json_object_stats_entry_(HashTrieStats *stats, JsonObjectEntry *entry, size_t depth)
+{
+	size_t children = 0;
+	for(size_t i = 0; i < stats->slots; ++i)
+	{
+		if(entry->child[i])
+		{
+			children++;
+			json_object_stats_entry_(stats, entry->child[i], depth + 1);
+		}
+	}
+	hash_trie_stats_level_(stats, depth, children);
+	stats->key_bytes += entry->key.length + 1; // parse_json copies every key, terminator included
+}
+
+void json_object_stats(JsonObject *map, HashTrieStats *stats)
+{
+	memset(stats, 0, sizeof(HashTrieStats));
+	stats->slots = sizeof(map->head->child) / sizeof(map->head->child[0]);
+	// The first entry is also the root of the trie
+	if(map->head)
+		json_object_stats_entry_(stats, map->head, 0);
+	if(stats->nodes)
+		stats->mean_depth /= stats->nodes;
+	stats->total_bytes = stats->nodes * sizeof(JsonObjectEntry) + stats->key_bytes;
+}
+
 #include <pdjson/pdjson.h>
 
 void json_value_print(JsonValue v)
@@ -170,4 +192,14 @@ JsonValue parse_json(const char *jstr, JsonAllocatorFn allocator)
 	JsonValue val = parse_json_value(&json, allocator);
 	json_close(&json);
     return val;
+}
+
+JsonValue parse_json_buffer(const void *data, size_t length, JsonAllocatorFn allocator)
+{
+	json_stream json;
+	json_open_buffer(&json, data, length);
+	json_set_streaming(&json, false);
+	JsonValue val = parse_json_value(&json, allocator);
+	json_close(&json);
+    return val;
 }
\ No newline at end of file
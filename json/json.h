@@ -1,6 +1,7 @@
 #pragma once
 #include <stdbool.h>
 #include <stddef.h>
+#include <stli/hash_trie.h>
 
 // typedef enum
 // {
@@ -60,7 +61,12 @@ struct JsonObjectEntry
 
 typedef void *(*JsonAllocatorFn)(size_t);
 JsonValue parse_json(const char *jstr, JsonAllocatorFn allocator);
+// Same as parse_json for data that isn't zero terminated, e.g. straight from stream_mmap_pointer.
+JsonValue parse_json_buffer(const void *data, size_t length, JsonAllocatorFn allocator);
 JsonObjectEntry *json_object_upsert(JsonObject *map, JsonString key, JsonAllocatorFn allocator);
+// Shape of an object's key trie. Keys are copies owned by the DOM, total_bytes counts the entries and those copies but
+// not what nested values point to.
+void json_object_stats(JsonObject *map, HashTrieStats *stats);
 
 void json_value_print(JsonValue v);
 JsonValue json_object_get(JsonValue, const char *path);
\ No newline at end of file
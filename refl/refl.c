@@ -4,7 +4,9 @@
 #include <stli/parse/lexer.h>
 #include <stli/util.h>
 #include <stli/hash_trie.h>
+#include <stli/hash_trie_frozen.h>
 #include <stli/hash.h>
+#include <stli/intern.h>
 #include <assert.h>
 #include <stdarg.h>
 #include <inttypes.h>
@@ -12,6 +14,7 @@
 typedef struct
 {
 	char string[1024];
+	Token token; // Last accepted token, string holds its text
 	Lexer *lexer;
 } Parser;
 
@@ -30,7 +33,7 @@ typedef struct
 	int type;
 	union
 	{
-		char *text;
+		const char *text; // Interned
 		int integer;
 		float value;
 	} u;
@@ -38,8 +41,8 @@ typedef struct
 
 typedef struct
 {
-	char *type;
-	char *name;
+	Symbol type; // 0 for function pointers
+	Symbol name;
 	int flags;
 	int ptr;
 	Value size;
@@ -49,7 +52,7 @@ typedef struct
 
 typedef struct
 {
-	char *name;
+	Symbol name;
 	HashTrie fields;
 } Struct;
 
@@ -70,10 +73,21 @@ static int accept(Parser *parser, int which, const char **strval)
 			return -1;
 	}
 	lexer_token_read_string(l, &t, parser->string, sizeof(parser->string));
+	parser->token = t;
 	if(strval)
 		*strval = parser->string;
 	return t.token_type;
 }
+
+// Case sensitive hash trie hash of the last accepted token, the lexer already computed it unless the text got
+// truncated when it was read into parser->string.
+static uint64_t token_hash(Parser *parser)
+{
+	size_t n = strlen(parser->string);
+	if(parser->token.length == n)
+		return parser->token.hash;
+	return hash_trie_hash(parser->string, n, true);
+}
 static void expect(Parser *parser, int which, const char **strval, char *errmsg)
 {
 	Lexer *l = parser->lexer;
@@ -92,7 +106,19 @@ static void allocator_free_(void *ctx, void *ptr)
 {
 	free(ptr);
 }
-static Allocator malloc_allocator = { allocator_malloc_, allocator_free_, 0 };
+static void *allocator_realloc_(void *ctx, void *ptr, size_t old_size, size_t new_size)
+{
+	return realloc(ptr, new_size);
+}
+static Allocator malloc_allocator = { allocator_malloc_, allocator_free_, 0, allocator_realloc_ };
+// Type, field and struct names, identifiers repeat a lot so each is only stored once
+static Interner symbols;
+
+// Interns the text of the last accepted token
+static Symbol intern_token(Parser *parser)
+{
+	return intern_hashed(&symbols, parser->string, strlen(parser->string), token_hash(parser));
+}
 Value value(Parser *parser)
 {
 	Value v = { 0 };
@@ -101,16 +127,17 @@ Value value(Parser *parser)
 	if(lexer_step(parser->lexer, &t))
 		return v;
 	lexer_token_read_string(parser->lexer, &t, parser->string, sizeof(parser->string));
+	parser->token = t;
 
 	switch(t.token_type)
 	{
 		case TOKEN_TYPE_IDENTIFIER:
 			v.type = VALUE_IDENTIFIER;
-			v.u.text = strdup(parser->string);
+			v.u.text = interner_string(&symbols, intern_token(parser));
 			break;
 		case TOKEN_TYPE_STRING:
 			v.type = VALUE_STRING;
-			v.u.text = strdup(parser->string);
+			v.u.text = interner_string(&symbols, intern_token(parser));
 			break;
 		case TOKEN_TYPE_NUMBER:
 			v.type = t.flags & TOKEN_FLAG_DECIMAL_POINT ? VALUE_FLOAT : VALUE_INTEGER;
@@ -181,19 +208,19 @@ static void parse_fields(Parser *parser, HashTrie *fields)
 				;
 			continue;
 		}
-		f->type = strdup(str);
+		f->type = intern_token(parser);
 		while(accept(parser, '*', NULL) > 0)
 		{
 			f->ptr++;
 		}
 		if(accept(parser, '(', NULL) > 0)
 		{
-			f->type = "()";
+			f->type = 0;
 			f->ptr = 1;
 			while(accept(parser, -1, &str) != '*')
 				;
 			expect(parser, TOKEN_TYPE_IDENTIFIER, &str, "Expected name for function pointer");
-			f->name = strdup(str);
+			f->name = intern_token(parser);
 			parse_array(parser, f);
 			while(accept(parser, -1, &str) != ')')
 				;
@@ -203,14 +230,15 @@ static void parse_fields(Parser *parser, HashTrie *fields)
 			result = accept(parser, -1, &str);
 			if(result <= 0 || result == '}')
 				break;
-			f->name = strdup(str);
+			f->name = intern_token(parser);
 			// printf("%s %s\n", f.type.name, f.name);
 			parse_array(parser, f);
 		}
 		while(accept(parser, -1, &str) != ';')
 			;
 		// printf("Field: %s %s [%d]\n", f->type, f->name, f->size);
-		hash_trie_upsert(fields, f->name, &malloc_allocator, true)->value = f;
+		hash_trie_upsert_n(fields, interner_string(&symbols, f->name), interner_length(&symbols, f->name),
+						   interner_hash(&symbols, f->name), &malloc_allocator, true)->value = f;
 	}
 }
 
@@ -241,20 +269,20 @@ static void parse(Parser *parser, HashTrie *header_exports, HashTrie *structs)
 						parse_fields(parser, &s->fields);
 					}
 					expect(parser, TOKEN_TYPE_IDENTIFIER, &id, "Expected struct name");
-					s->name = strdup(id);
-					hash_trie_upsert(structs, s->name, &malloc_allocator, false)->value = s;
+					s->name = intern_token(parser);
+					hash_trie_upsert(structs, interner_string(&symbols, s->name), &malloc_allocator, false)->value = s;
 				}
 			}
 			else if(!strcmp(id, "struct"))
 			{
 				Struct *s = calloc(1, sizeof(Struct));
 				expect(parser, TOKEN_TYPE_IDENTIFIER, &id, "Expected struct type name");
-				s->name = strdup(id);
+				s->name = intern_token(parser);
 				if(!lexer_accept(l, '{', NULL))
 				{
 					parse_fields(parser, &s->fields);
 				}
-				hash_trie_upsert(structs, s->name, &malloc_allocator, false)->value = s;
+				hash_trie_upsert(structs, interner_string(&symbols, s->name), &malloc_allocator, false)->value = s;
 			}
 		} else if(type == TOKEN_TYPE_STRING)
 		{
@@ -280,7 +308,7 @@ int main(int argc, char **argv)
 	// if(read_text_file(filename, &arena, &source))
 	// 	return 1;
 	Stream stream = { 0 };
-	if(stream_open_file(&stream, filename, "r"))
+	if(stream_open_mmap(&stream, filename))
 		return 1;
 	Lexer lexer = { 0 };
 	Parser parser = { 0 };
@@ -292,6 +320,7 @@ int main(int argc, char **argv)
 		fprintf(stderr, "Failed to parse '%s'\n", filename);
 		return 1;
 	}
+	interner_init(&symbols, &malloc_allocator);
 	HashTrie header_exports;
 	HashTrie structs;
 	parse(&parser, &header_exports, &structs);
@@ -300,13 +329,14 @@ int main(int argc, char **argv)
 	for(HashTrieNode *it = structs.head; it; it = it->next)
 	{
 		Struct *s = it->value;
-		printf("%s\n", s->name);
+		printf("%s\n", interner_string(&symbols, s->name));
 		for(HashTrieNode *field_it = s->fields.head; field_it; field_it = field_it->next)
 		{
 			Field *f = field_it->value;
 			value_string(&f->size, parser.string, sizeof(parser.string));
-			printf("\t%s %s %s\n", f->name, f->type, parser.string);
-			hash_trie_upsert(&types, f->type, &malloc_allocator, false);
+			const char *type = f->type ? interner_string(&symbols, f->type) : "()";
+			printf("\t%s %s %s\n", interner_string(&symbols, f->name), type, parser.string);
+			hash_trie_upsert(&types, type, &malloc_allocator, false);
 		}
 	}
 	char directory[512];
@@ -315,9 +345,13 @@ int main(int argc, char **argv)
 	char sep;
 	pathinfo(filename, directory, sizeof(directory), basename, sizeof(basename), extension, sizeof(extension), &sep);
 	char header_path[512];
+	// No more structs get added from here on
+	FrozenHashTrie frozen_structs;
+	if(!hash_trie_freeze(&frozen_structs, &structs, &malloc_allocator))
+		return 1;
 	for(HashTrieNode *it = header_exports.head; it; it = it->next)
 	{
-		HashTrieNode *n = hash_trie_upsert(&structs, it->key, NULL, false);
+		FrozenHashTrieEntry *n = frozen_hash_trie_lookup_n(&frozen_structs, it->key, it->length, it->hash, false);
 		if(!n)
 			continue;
 		Struct *s = n->value;
@@ -413,7 +447,8 @@ fprintf(hdr, "	}\n");
 fprintf(hdr, "	return field;\n");
 fprintf(hdr, "}\n");
 fprintf(hdr, "#endif\n");
-		fprintf(hdr, "ReflFieldInfo %s_refl_fields[] = {\n", s->name);
+		const char *struct_name = interner_string(&symbols, s->name);
+		fprintf(hdr, "ReflFieldInfo %s_refl_fields[] = {\n", struct_name);
 		for(HashTrieNode *field_it = s->fields.head; field_it; field_it = field_it->next)
 		{
 			Field *f = field_it->value;
@@ -424,7 +459,9 @@ fprintf(hdr, "#endif\n");
 				if(f->size.type != VALUE_INTEGER || f->size.u.integer != 0)
 					continue;
 			}
-			fprintf(hdr, "\t{\"%s\", offsetof(%s, %s), \"%s\", refl_%s_to_string, refl_%s_from_string},\n", f->name, s->name, f->name, f->type, f->type, f->type);
+			const char *name = interner_string(&symbols, f->name);
+			const char *type = f->type ? interner_string(&symbols, f->type) : "()";
+			fprintf(hdr, "\t{\"%s\", offsetof(%s, %s), \"%s\", refl_%s_to_string, refl_%s_from_string},\n", name, struct_name, name, type, type, type);
 		}
 		fprintf(hdr, "\t{NULL, 0, NULL}\n");
 		fprintf(hdr, "};");
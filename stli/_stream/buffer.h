@@ -3,14 +3,48 @@
 #include "stream.h"
 #include <string.h>
 #include <malloc.h>
+#include <stli/allocator.h>
 
+// Reads and writes over a block of memory. length is how many bytes hold data, which is where reads stop and what eof
+// checks, capacity is how many the block has room for. Writes past the capacity call grow, without one they fail.
+// Writes put a NUL after themselves when there's room, which isn't counted in length (see stream_write_).
 typedef struct StreamBuffer_s
 {
-	size_t offset, length;//, capacity;
+	size_t offset, length, capacity;
 	unsigned char *buffer;
+	// Has to make room for at least size bytes and update buffer and capacity, length is left alone
 	bool (*grow)(struct StreamBuffer_s*, size_t size);
+	Allocator *allocator; // Set by init_stream_from_allocator, NULL there means libc
 } StreamBuffer;
 
+// Doubles the capacity until size fits, through sb->allocator or libc when that's NULL. Keeps one byte past the
+// capacity so the data is always zero terminated.
+static bool stream_buffer_grow_(struct StreamBuffer_s *sb, size_t size)
+{
+	size_t capacity = sb->capacity ? sb->capacity : 64;
+	while(capacity < size)
+		capacity *= 2;
+	unsigned char *buffer;
+	if(sb->allocator)
+		buffer = (unsigned char *)allocator_realloc(sb->allocator, sb->buffer, sb->buffer ? sb->capacity + 1 : 0, capacity + 1);
+	else
+		buffer = (unsigned char *)realloc(sb->buffer, capacity + 1);
+	if(!buffer)
+		return false;
+	buffer[sb->length] = 0;
+	sb->buffer = buffer;
+	sb->capacity = capacity;
+	return true;
+}
+
+// Puts a NUL after the data when there's room for one, without counting it in length. Buffers that own their memory
+// always have room, there's a byte past the capacity for it.
+static void stream_buffer_terminate_(StreamBuffer *sb)
+{
+	if(sb->length < sb->capacity || sb->grow == stream_buffer_grow_)
+		sb->buffer[sb->length] = 0;
+}
+
 static size_t stream_read_(struct Stream_s *stream, void *ptr, size_t size, size_t nmemb)
 {
 	StreamBuffer *sd = (StreamBuffer *)stream->ctx;
@@ -18,36 +52,63 @@ static size_t stream_read_(struct Stream_s *stream, void *ptr, size_t size, size
 	if(sd->offset + nb > sd->length)
 	{
 		/* printf("overflow offset:%d,nb:%d,length:%d,size:%d,nmemb:%d\n",sd->offset,nb,sd->length,size,nmemb); */
-		// return 0; // EOF
-		nb = sd->length - sd->offset;
+		nb = sd->offset < sd->length ? sd->length - sd->offset : 0;
 	}
 	if(nb == 0)
 		return 0;
 	memcpy(ptr, &sd->buffer[sd->offset], nb);
 	/* printf("reading %d (%d/%d)\n", nb, sd->offset, sd->length); */
 	sd->offset += nb;
-	return nmemb;
+	// Same as fread, a partially read element isn't counted
+	return nb / size;
 }
 
 static size_t stream_write_(struct Stream_s *stream, const void *ptr, size_t size, size_t nmemb)
 {
 	StreamBuffer *sd = (StreamBuffer *)stream->ctx;
 	size_t nb = size * nmemb;
-	if(sd->offset + nb > sd->length)
+	if(sd->offset + nb > sd->capacity)
 	{
-		if(!sd->grow)
+		if(!sd->grow || !sd->grow(sd, sd->offset + nb))
 		{
 			/* printf("overflow offset:%d,nb:%d,length:%d,size:%d,nmemb:%d\n",sd->offset,nb,sd->length,size,nmemb); */
 			return 0; // EOF
 		}
-		sd->grow(sd, sd->offset + nb);
 	}
 	memcpy(&sd->buffer[sd->offset], ptr, nb);
 	/* printf("writing %d (%d/%d)\n", nb, sd->offset, sd->length); */
 	sd->offset += nb;
+	if(sd->offset > sd->length)
+		sd->length = sd->offset;
+	// Buffers that own their memory get a NUL after the end of the data. In a caller's buffer the byte after the write
+	// is zeroed whenever it fits, so text written into a fixed buffer (length == capacity) still reads as a string.
+	if(sd->grow == stream_buffer_grow_ ? sd->offset == sd->length : sd->offset < sd->capacity)
+		sd->buffer[sd->offset] = 0;
 	return nmemb;
 }
 
+static const uint8_t *stream_window_buffer_(struct Stream_s *stream, size_t *n)
+{
+	StreamBuffer *sd = (StreamBuffer *)stream->ctx;
+	*n = sd->offset < sd->length ? sd->length - sd->offset : 0;
+	return sd->buffer + sd->offset;
+}
+
+static void stream_consume_buffer_(struct Stream_s *stream, size_t n)
+{
+	StreamBuffer *sd = (StreamBuffer *)stream->ctx;
+	sd->offset += n;
+}
+
+static int stream_unget_buffer_(struct Stream_s *stream, size_t n)
+{
+	StreamBuffer *sd = (StreamBuffer *)stream->ctx;
+	if(n > sd->offset)
+		return 1;
+	sd->offset -= n;
+	return 0;
+}
+
 static int stream_eof_(struct Stream_s *stream)
 {
 	StreamBuffer *sd = (StreamBuffer *)stream->ctx;
@@ -109,36 +170,88 @@ static int stream_seek_(struct Stream_s *s, int64_t offset, int whence)
 static int init_stream_from_stream_buffer(Stream *s, StreamBuffer *sb)
 {	
 	s->ctx = sb;
+	s->flags = STREAM_FLAG_NO_TERMINATOR; // Writes terminate the data themselves
 	s->read = stream_read_;
 	s->write = stream_write_;
 	s->eof = stream_eof_;
 	s->name = stream_name_;
 	s->tell = stream_tell_;
 	s->seek = stream_seek_;
+	s->window = stream_window_buffer_;
+	s->consume = stream_consume_buffer_;
+	s->unget = stream_unget_buffer_;
+	s->mark = NULL;
+	s->vprintf = NULL;
 	return 0;
 }
 
+// Reads and writes over length bytes at buffer, the stream can't grow past them.
 static int init_stream_from_buffer(Stream *s, StreamBuffer *sb, unsigned char *buffer, size_t length)
 {
 	sb->offset = 0;
 	sb->length = length;
 	sb->buffer = buffer;
-	// sb->capacity = length;
+	sb->capacity = length;
 	sb->grow = NULL;
-	
-	s->ctx = sb;
-	s->read = stream_read_;
-	s->write = stream_write_;
-	s->eof = stream_eof_;
-	s->name = stream_name_;
-	s->tell = stream_tell_;
-	s->seek = stream_seek_;
+	sb->allocator = NULL;
+	return init_stream_from_stream_buffer(s, sb);
+}
+
+// An empty stream that owns its memory and grows as it's written to, a is NULL to use libc. capacity is how much to
+// allocate up front, can be 0. The data stays zero terminated, so sb->buffer can be used as a string as is.
+// Returns zero if successful.
+static int init_stream_from_allocator(Stream *s, StreamBuffer *sb, Allocator *a, size_t capacity)
+{
+	memset(sb, 0, sizeof(StreamBuffer));
+	sb->grow = stream_buffer_grow_;
+	sb->allocator = a;
+	if(!stream_buffer_grow_(sb, capacity))
+		return 1;
+	init_stream_from_stream_buffer(s, sb);
 	return 0;
 }
 
+// Makes sure capacity bytes fit without growing again, returns false if it can't.
+static bool stream_buffer_reserve(StreamBuffer *sb, size_t capacity)
+{
+	if(capacity <= sb->capacity)
+		return true;
+	return sb->grow && sb->grow(sb, capacity);
+}
+
+// Adds n bytes after the data, wherever the stream position is, so one stage can keep appending while the next one
+// reads. Growth doubles, so appending is amortized constant time. Returns false if it doesn't fit.
+static bool stream_buffer_append(StreamBuffer *sb, const void *data, size_t n)
+{
+	if(!stream_buffer_reserve(sb, sb->length + n))
+		return false;
+	memcpy(sb->buffer + sb->length, data, n);
+	sb->length += n;
+	stream_buffer_terminate_(sb);
+	return true;
+}
+
+// Frees the memory of a stream set up with init_stream_from_allocator.
+static void stream_buffer_release(StreamBuffer *sb)
+{
+	if(sb->grow == stream_buffer_grow_ && sb->buffer)
+	{
+		if(sb->allocator)
+			sb->allocator->free(sb->allocator->ctx, sb->buffer);
+		else
+			free(sb->buffer);
+	}
+	sb->buffer = NULL;
+	sb->offset = sb->length = sb->capacity = 0;
+}
+
 static bool stream_buffer_buffer_grow_realloc(struct StreamBuffer_s *sb, size_t size)
 {
-    sb->buffer = (unsigned char*)realloc(sb->buffer, size * 2);
-    sb->length = size * 2;
+	size_t capacity = size * 2;
+	unsigned char *buffer = (unsigned char*)realloc(sb->buffer, capacity);
+	if(!buffer)
+		return false;
+	sb->buffer = buffer;
+	sb->capacity = capacity;
 	return true;
 }
@@ -4,27 +4,138 @@
 #include <string.h>
 #include <stdio.h>
 
+#define STREAM_FILE_BUFFER_SIZE (4096)
+#define STREAM_FILE_PUSHBACK (256) // Bytes before the position that survive a refill
+
+// Reads go through an internal buffer which is what window hands out, tell and seek within the buffered bytes don't
+// touch the FILE at all. A refill keeps the last STREAM_FILE_PUSHBACK bytes and, if it fits, everything from the mark
+// on, so ungetting and going back to a mark don't either. Positions are counted in bytes read, so in text mode on
+// Windows they may not line up with what ftell would report.
 typedef struct
 {
     char path[256];
 	FILE *fp;
+	int64_t buffer_offset; // File position of buffer[0], the FILE is at buffer_offset + buffer_length
+	size_t buffer_pos, buffer_length;
+	int64_t mark; // -1 if not set
+	unsigned char buffer[STREAM_FILE_BUFFER_SIZE];
 } StreamFile;
 
+// Drops whatever is buffered and puts the FILE back at the stream position
+static int stream_file_sync_(StreamFile *sd)
+{
+	size_t ahead = sd->buffer_length - sd->buffer_pos;
+	sd->buffer_offset += sd->buffer_pos;
+	sd->buffer_pos = sd->buffer_length = 0;
+	return ahead ? fseek(sd->fp, sd->buffer_offset, SEEK_SET) : 0;
+}
+
+// Only called once everything buffered has been consumed, returns the number of new bytes.
+static size_t stream_file_refill_(StreamFile *sd)
+{
+	size_t keep = sd->buffer_pos < STREAM_FILE_PUSHBACK ? sd->buffer_pos : STREAM_FILE_PUSHBACK;
+	size_t drop = sd->buffer_pos - keep;
+	if(sd->mark >= sd->buffer_offset && sd->mark < sd->buffer_offset + (int64_t)drop)
+	{
+		size_t m = sd->mark - sd->buffer_offset;
+		if(sd->buffer_length - m < sizeof(sd->buffer)) // Still leaves room to read into
+			drop = m;
+	}
+	memmove(sd->buffer, sd->buffer + drop, sd->buffer_length - drop);
+	sd->buffer_offset += drop;
+	sd->buffer_length -= drop;
+	sd->buffer_pos -= drop;
+	size_t n = fread(sd->buffer + sd->buffer_length, 1, sizeof(sd->buffer) - sd->buffer_length, sd->fp);
+	sd->buffer_length += n;
+	return n;
+}
+
 static size_t stream_read_file_(struct Stream_s *stream, void *ptr, size_t size, size_t nmemb)
 {
 	StreamFile *sd = (StreamFile *)stream->ctx;
-	return fread(ptr, size, nmemb, sd->fp);
+	size_t nb = size * nmemb;
+	size_t n = 0;
+	while(n < nb)
+	{
+		size_t avail = sd->buffer_length - sd->buffer_pos;
+		if(!avail)
+		{
+			if(nb - n >= sizeof(sd->buffer))
+			{
+				// Large reads skip the buffer, only their tail is copied in to keep the pushback
+				size_t direct = fread((char *)ptr + n, 1, nb - n, sd->fp);
+				n += direct;
+				size_t keep = n < STREAM_FILE_PUSHBACK ? n : STREAM_FILE_PUSHBACK;
+				memcpy(sd->buffer, (char *)ptr + n - keep, keep);
+				sd->buffer_offset += sd->buffer_length + direct - keep;
+				sd->buffer_pos = sd->buffer_length = keep;
+				break;
+			}
+			avail = stream_file_refill_(sd);
+			if(!avail)
+				break;
+		}
+		if(avail > nb - n)
+			avail = nb - n;
+		memcpy((char *)ptr + n, sd->buffer + sd->buffer_pos, avail);
+		sd->buffer_pos += avail;
+		n += avail;
+	}
+	// Same as fread, a partially read element isn't counted but the position stays after it
+	return size ? n / size : 0;
 }
 
 static size_t stream_write_file_(struct Stream_s *stream, const void *ptr, size_t size, size_t nmemb)
 {
 	StreamFile *sd = (StreamFile *)stream->ctx;
-    return fwrite(ptr, size, nmemb, sd->fp);
+	stream_file_sync_(sd);
+	size_t n = fwrite(ptr, size, nmemb, sd->fp);
+	sd->buffer_offset += n * size;
+    return n;
+}
+
+static const uint8_t *stream_window_file_(struct Stream_s *stream, size_t *n)
+{
+	StreamFile *sd = (StreamFile *)stream->ctx;
+	if(sd->buffer_pos >= sd->buffer_length)
+		stream_file_refill_(sd);
+	*n = sd->buffer_length - sd->buffer_pos;
+	return sd->buffer + sd->buffer_pos;
+}
+
+static void stream_consume_file_(struct Stream_s *stream, size_t n)
+{
+	StreamFile *sd = (StreamFile *)stream->ctx;
+	sd->buffer_pos += n;
+}
+
+static int stream_unget_file_(struct Stream_s *stream, size_t n)
+{
+	StreamFile *sd = (StreamFile *)stream->ctx;
+	if(n <= sd->buffer_pos)
+	{
+		sd->buffer_pos -= n;
+		return 0;
+	}
+	int64_t position = sd->buffer_offset + sd->buffer_pos - n;
+	if(position < 0 || fseek(sd->fp, position, SEEK_SET))
+		return 1;
+	sd->buffer_pos = sd->buffer_length = 0;
+	sd->buffer_offset = position;
+	return 0;
+}
+
+static void stream_mark_file_(struct Stream_s *stream, int64_t position)
+{
+	StreamFile *sd = (StreamFile *)stream->ctx;
+	sd->mark = position;
 }
 
 static int stream_eof_file_(struct Stream_s *stream)
 {
 	StreamFile *sd = (StreamFile *)stream->ctx;
+	if(sd->buffer_pos < sd->buffer_length)
+		return 0;
     return feof(sd->fp);
 }
 
@@ -38,7 +149,7 @@ static int stream_name_file_(struct Stream_s *s, char *buffer, size_t size)
 static int64_t stream_tell_file_(struct Stream_s *s)
 {
 	StreamFile *sd = (StreamFile *)s->ctx;
-    return ftell(sd->fp);
+    return sd->buffer_offset + sd->buffer_pos;
 }
 
 static int stream_seek_file_(struct Stream_s *s, int64_t offset, int whence)
@@ -48,17 +159,32 @@ static int stream_seek_file_(struct Stream_s *s, int64_t offset, int whence)
 	{
 		case STREAM_SEEK_BEG:
 		{
-            return fseek(sd->fp, offset, SEEK_SET);
+			// Anywhere within the buffered bytes is just a matter of moving buffer_pos
+			if(offset >= sd->buffer_offset && offset <= sd->buffer_offset + (int64_t)sd->buffer_length)
+			{
+				sd->buffer_pos = offset - sd->buffer_offset;
+				return 0;
+			}
+			// The buffer only goes once the FILE is there, a failed seek leaves the position as it was
+			if(offset < 0 || fseek(sd->fp, offset, SEEK_SET))
+				return 1;
+			sd->buffer_pos = sd->buffer_length = 0;
+			sd->buffer_offset = offset;
+			return 0;
 		}
 		break;
 		case STREAM_SEEK_CUR:
 		{
-            return fseek(sd->fp, offset, SEEK_CUR);
+            return stream_seek_file_(s, stream_tell_file_(s) + offset, STREAM_SEEK_BEG);
 		}
 		break;
 		case STREAM_SEEK_END:
 		{
-            return fseek(sd->fp, offset, SEEK_END);
+			if(fseek(sd->fp, offset, SEEK_END))
+				return 1;
+			sd->buffer_pos = sd->buffer_length = 0;
+			sd->buffer_offset = ftell(sd->fp);
+			return 0;
 		}
 		break;
 	}
@@ -72,14 +198,23 @@ static int stream_open_file(Stream *s, const char *path, const char *mode)
         return 1;
     StreamFile *sf = malloc(sizeof(StreamFile));
     sf->fp = fp;
+	sf->buffer_offset = ftell(fp); // Not 0 in append mode
+	sf->buffer_pos = sf->buffer_length = 0;
+	sf->mark = -1;
     snprintf(sf->path, sizeof(sf->path), "%s", path);
 	s->ctx = sf;
+	s->flags = STREAM_FLAG_NO_TERMINATOR; // A NUL would end up in the file
 	s->read = stream_read_file_;
 	s->write = stream_write_file_;
 	s->eof = stream_eof_file_;
 	s->name = stream_name_file_;
 	s->tell = stream_tell_file_;
 	s->seek = stream_seek_file_;
+	s->window = stream_window_file_;
+	s->consume = stream_consume_file_;
+	s->unget = stream_unget_file_;
+	s->mark = stream_mark_file_;
+	s->vprintf = NULL;
     return 0;
 }
 
@@ -0,0 +1,220 @@
+#pragma once
+
+#include "stream.h"
+#include <string.h>
+#include <stdio.h>
+
+// Read-only stream over a file mapped into memory. Reads are a memcpy out of the page cache, nothing is loaded up
+// front and processes mapping the same file share its pages. stream_mmap_pointer gives direct access to the bytes
+// for code that can work on them in place.
+
+#ifdef _WIN32
+	#include <windows.h>
+#else
+	#include <sys/mman.h>
+	#include <sys/stat.h>
+	#include <fcntl.h>
+	#include <unistd.h>
+#endif
+
+typedef struct
+{
+	char path[256];
+	const unsigned char *data; // NULL for an empty file
+	size_t size;
+	size_t offset;
+#ifdef _WIN32
+	HANDLE file;
+	HANDLE mapping;
+#endif
+} StreamMmap;
+
+static size_t stream_read_mmap_(struct Stream_s *stream, void *ptr, size_t size, size_t nmemb)
+{
+	StreamMmap *sm = (StreamMmap *)stream->ctx;
+	if(!size)
+		return 0;
+	size_t available = sm->size - sm->offset;
+	if(nmemb > available / size)
+		nmemb = available / size;
+	size_t nb = size * nmemb;
+	if(nb)
+		memcpy(ptr, sm->data + sm->offset, nb);
+	sm->offset += nb;
+	return nmemb;
+}
+
+static size_t stream_write_mmap_(struct Stream_s *stream, const void *ptr, size_t size, size_t nmemb)
+{
+	return 0; // Read-only
+}
+
+static int stream_eof_mmap_(struct Stream_s *stream)
+{
+	StreamMmap *sm = (StreamMmap *)stream->ctx;
+	return sm->offset >= sm->size;
+}
+
+static int stream_name_mmap_(struct Stream_s *s, char *buffer, size_t size)
+{
+	StreamMmap *sm = (StreamMmap *)s->ctx;
+	snprintf(buffer, size, "%s", sm->path);
+	return 0;
+}
+
+static int64_t stream_tell_mmap_(struct Stream_s *s)
+{
+	StreamMmap *sm = (StreamMmap *)s->ctx;
+	return sm->offset;
+}
+
+static int stream_seek_mmap_(struct Stream_s *s, int64_t offset, int whence)
+{
+	StreamMmap *sm = (StreamMmap *)s->ctx;
+	int64_t current = 0;
+	switch(whence)
+	{
+		case STREAM_SEEK_BEG: current = 0; break;
+		case STREAM_SEEK_CUR: current = (int64_t)sm->offset; break;
+		case STREAM_SEEK_END: current = (int64_t)sm->size; break;
+	}
+	current += offset;
+	// Clamped the same as the buffer backend
+	if(current < 0)
+		current = 0;
+	if((uint64_t)current > sm->size)
+		current = sm->size;
+	sm->offset = current;
+	return 0;
+}
+
+static const uint8_t *stream_window_mmap_(struct Stream_s *s, size_t *n)
+{
+	StreamMmap *sm = (StreamMmap *)s->ctx;
+	*n = sm->size - sm->offset;
+	return sm->data ? sm->data + sm->offset : NULL;
+}
+
+static void stream_consume_mmap_(struct Stream_s *s, size_t n)
+{
+	StreamMmap *sm = (StreamMmap *)s->ctx;
+	sm->offset += n;
+}
+
+static int stream_unget_mmap_(struct Stream_s *s, size_t n)
+{
+	StreamMmap *sm = (StreamMmap *)s->ctx;
+	if(n > sm->offset)
+		return 1;
+	sm->offset -= n;
+	return 0;
+}
+
+// Bytes from the current position to the end of the file, valid until the stream is closed.
+static const unsigned char *stream_mmap_pointer(Stream *s, size_t *remaining)
+{
+	StreamMmap *sm = (StreamMmap *)s->ctx;
+	*remaining = sm->size - sm->offset;
+	return sm->data ? sm->data + sm->offset : NULL;
+}
+
+static int stream_open_mmap(Stream *s, const char *path)
+{
+	StreamMmap *sm = calloc(1, sizeof(StreamMmap));
+	if(!sm)
+		return 1;
+#ifdef _WIN32
+	HANDLE file = CreateFileA(path, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+	LARGE_INTEGER size;
+	if(file == INVALID_HANDLE_VALUE || !GetFileSizeEx(file, &size))
+	{
+		if(file != INVALID_HANDLE_VALUE)
+			CloseHandle(file);
+		free(sm);
+		return 1;
+	}
+	if(size.QuadPart > 0)
+	{
+		sm->mapping = CreateFileMappingA(file, NULL, PAGE_READONLY, 0, 0, NULL);
+		if(sm->mapping)
+			sm->data = MapViewOfFile(sm->mapping, FILE_MAP_READ, 0, 0, 0);
+		if(!sm->data)
+		{
+			if(sm->mapping)
+				CloseHandle(sm->mapping);
+			CloseHandle(file);
+			free(sm);
+			return 1;
+		}
+	}
+	sm->file = file;
+	sm->size = size.QuadPart;
+#else
+	int fd = open(path, O_RDONLY);
+	if(fd == -1)
+	{
+		free(sm);
+		return 1;
+	}
+	struct stat st;
+	if(fstat(fd, &st))
+	{
+		close(fd);
+		free(sm);
+		return 1;
+	}
+	if(st.st_size > 0)
+	{
+		void *p = mmap(NULL, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+		if(p == MAP_FAILED)
+		{
+			close(fd);
+			free(sm);
+			return 1;
+		}
+#ifdef MADV_SEQUENTIAL // Not declared in strict ISO C modes
+		madvise(p, st.st_size, MADV_SEQUENTIAL);
+#endif
+		sm->data = p;
+	}
+	close(fd); // The mapping keeps the file alive
+	sm->size = st.st_size;
+#endif
+	snprintf(sm->path, sizeof(sm->path), "%s", path);
+	s->ctx = sm;
+	s->flags = STREAM_FLAG_NONE;
+	s->read = stream_read_mmap_;
+	s->write = stream_write_mmap_;
+	s->eof = stream_eof_mmap_;
+	s->name = stream_name_mmap_;
+	s->tell = stream_tell_mmap_;
+	s->seek = stream_seek_mmap_;
+	s->window = stream_window_mmap_;
+	s->consume = stream_consume_mmap_;
+	s->unget = stream_unget_mmap_;
+	s->mark = NULL; // Everything stays mapped anyway
+	s->vprintf = NULL;
+	return 0;
+}
+
+static int stream_close_mmap(Stream *s)
+{
+	if(!s->ctx)
+	{
+		return 1;
+	}
+	StreamMmap *sm = s->ctx;
+#ifdef _WIN32
+	if(sm->data)
+		UnmapViewOfFile(sm->data);
+	if(sm->mapping)
+		CloseHandle(sm->mapping);
+	CloseHandle(sm->file);
+#else
+	if(sm->data)
+		munmap((void *)sm->data, sm->size);
+#endif
+	free(sm);
+	s->ctx = NULL;
+	return 0;
+}
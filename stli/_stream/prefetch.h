@@ -0,0 +1,390 @@
+#pragma once
+
+#include "stream.h"
+#include <string.h>
+#include <stdio.h>
+
+// Read-only file stream that reads ahead on a background thread. The file is read in large blocks into two buffers,
+// while one is being scanned the thread fills the other, so reading from disk overlaps with whatever the caller does
+// with the bytes. Works like StreamFile otherwise, window hands out the current block, tell/seek/unget within it and
+// the STREAM_FILE_PUSHBACK bytes before it are free, anything further away restarts the read-ahead at the new position.
+//
+// Stream s = { 0 };
+// if(!stream_open_prefetch(&s, "maps/e1m1.map"))
+// {
+//     lexer_init(&l, NULL, &s);
+//     ...
+//     stream_close_prefetch(&s);
+// }
+
+#ifdef _WIN32
+	#include <windows.h>
+#else
+	#include <pthread.h>
+#endif
+
+#ifndef STREAM_FILE_PUSHBACK
+	#define STREAM_FILE_PUSHBACK (256)
+#endif
+#define STREAM_PREFETCH_BLOCK_SIZE (1024 * 1024)
+
+enum
+{
+	STREAM_PREFETCH_BLOCK_EMPTY, // Up to the thread to fill
+	STREAM_PREFETCH_BLOCK_READY // Filled, belongs to the reader until it's given back
+};
+
+typedef struct
+{
+	unsigned char *memory; // STREAM_FILE_PUSHBACK bytes for the tail of the previous block, then the block itself
+	int64_t offset; // File position of the first byte of the block
+	size_t length;
+	size_t back; // Bytes of the previous block in front of it
+	bool last; // Hit the end of the file (or an error)
+	int state;
+} StreamPrefetchBlock;
+
+typedef struct
+{
+	char path[256];
+	FILE *fp; // Only touched by the thread once it runs
+	int64_t size;
+	StreamPrefetchBlock blocks[2];
+
+	// Everything below is shared with the thread and guarded by the lock, except for the reader's own fields
+	int fill; // Block the thread fills next
+	int64_t next_offset; // Where in the file that block starts
+	bool busy; // The thread is reading, it has the block at fill
+	bool done; // The thread reached the end of the file and waits for a seek
+	bool stop;
+#ifdef _WIN32
+	CRITICAL_SECTION lock;
+	CONDITION_VARIABLE cond;
+	HANDLE thread;
+#else
+	pthread_mutex_t lock;
+	pthread_cond_t cond;
+	pthread_t thread;
+#endif
+
+	// Reader
+	int current;
+	bool holding; // blocks[current] is READY and being read
+	size_t pos; // Index into blocks[current].memory
+	int64_t start; // The position while not holding a block
+} StreamPrefetch;
+
+#ifdef _WIN32
+static void stream_prefetch_lock_(StreamPrefetch *sp) { EnterCriticalSection(&sp->lock); }
+static void stream_prefetch_unlock_(StreamPrefetch *sp) { LeaveCriticalSection(&sp->lock); }
+static void stream_prefetch_wait_(StreamPrefetch *sp) { SleepConditionVariableCS(&sp->cond, &sp->lock, INFINITE); }
+static void stream_prefetch_wake_(StreamPrefetch *sp) { WakeAllConditionVariable(&sp->cond); }
+#else
+static void stream_prefetch_lock_(StreamPrefetch *sp) { pthread_mutex_lock(&sp->lock); }
+static void stream_prefetch_unlock_(StreamPrefetch *sp) { pthread_mutex_unlock(&sp->lock); }
+static void stream_prefetch_wait_(StreamPrefetch *sp) { pthread_cond_wait(&sp->cond, &sp->lock); }
+static void stream_prefetch_wake_(StreamPrefetch *sp) { pthread_cond_broadcast(&sp->cond); }
+#endif
+
+static void stream_prefetch_run_(StreamPrefetch *sp)
+{
+	int64_t file_position = 0;
+	stream_prefetch_lock_(sp);
+	while(1)
+	{
+		while(!sp->stop && (sp->done || sp->blocks[sp->fill].state != STREAM_PREFETCH_BLOCK_EMPTY))
+			stream_prefetch_wait_(sp);
+		if(sp->stop)
+			break;
+		StreamPrefetchBlock *b = &sp->blocks[sp->fill];
+		int64_t offset = sp->next_offset;
+		sp->busy = true;
+		stream_prefetch_unlock_(sp);
+
+		bool ok = offset == file_position || !fseek(sp->fp, offset, SEEK_SET);
+		size_t n = ok ? fread(b->memory + STREAM_FILE_PUSHBACK, 1, STREAM_PREFETCH_BLOCK_SIZE, sp->fp) : 0;
+		if(ok)
+			file_position = offset + (int64_t)n;
+		else
+			file_position = -1; // Unknown, the next read seeks
+
+		stream_prefetch_lock_(sp);
+		sp->busy = false;
+		b->offset = offset;
+		b->length = n;
+		b->back = 0;
+		b->last = n < STREAM_PREFETCH_BLOCK_SIZE;
+		b->state = STREAM_PREFETCH_BLOCK_READY;
+		sp->next_offset = offset + n;
+		sp->fill ^= 1;
+		sp->done = b->last;
+		stream_prefetch_wake_(sp);
+	}
+	stream_prefetch_unlock_(sp);
+}
+
+#ifdef _WIN32
+static DWORD WINAPI stream_prefetch_thread_(LPVOID arg)
+{
+	stream_prefetch_run_((StreamPrefetch *)arg);
+	return 0;
+}
+#else
+static void *stream_prefetch_thread_(void *arg)
+{
+	stream_prefetch_run_((StreamPrefetch *)arg);
+	return NULL;
+}
+#endif
+
+// Moves the reader on to the next block once the current one is used up, returns false at the end of the file.
+static bool stream_prefetch_next_(StreamPrefetch *sp)
+{
+	StreamPrefetchBlock *old = sp->holding ? &sp->blocks[sp->current] : NULL;
+	if(old && old->last)
+		return false;
+	if(old)
+		sp->current ^= 1;
+	stream_prefetch_lock_(sp);
+	while(sp->blocks[sp->current].state != STREAM_PREFETCH_BLOCK_READY)
+		stream_prefetch_wait_(sp);
+	stream_prefetch_unlock_(sp);
+
+	StreamPrefetchBlock *b = &sp->blocks[sp->current];
+	sp->holding = true;
+	sp->pos = STREAM_FILE_PUSHBACK;
+	if(old)
+	{
+		// Keep the tail of the old block in front of the new one, then let the thread have it
+		size_t keep = old->back + old->length < STREAM_FILE_PUSHBACK ? old->back + old->length : STREAM_FILE_PUSHBACK;
+		memcpy(b->memory + STREAM_FILE_PUSHBACK - keep, old->memory + STREAM_FILE_PUSHBACK + old->length - keep, keep);
+		b->back = keep;
+		stream_prefetch_lock_(sp);
+		old->state = STREAM_PREFETCH_BLOCK_EMPTY;
+		stream_prefetch_wake_(sp);
+		stream_prefetch_unlock_(sp);
+	}
+	return true;
+}
+
+// Throws away both blocks and has the thread start over at offset.
+static void stream_prefetch_restart_(StreamPrefetch *sp, int64_t offset)
+{
+	stream_prefetch_lock_(sp);
+	while(sp->busy)
+		stream_prefetch_wait_(sp);
+	for(int i = 0; i < 2; ++i)
+		sp->blocks[i].state = STREAM_PREFETCH_BLOCK_EMPTY;
+	sp->fill = 0;
+	sp->next_offset = offset;
+	sp->done = false;
+	stream_prefetch_wake_(sp);
+	stream_prefetch_unlock_(sp);
+	sp->current = 0;
+	sp->holding = false;
+	sp->start = offset;
+}
+
+static const uint8_t *stream_window_prefetch_(struct Stream_s *stream, size_t *n)
+{
+	StreamPrefetch *sp = (StreamPrefetch *)stream->ctx;
+	while(!sp->holding || sp->pos >= STREAM_FILE_PUSHBACK + sp->blocks[sp->current].length)
+	{
+		if(!stream_prefetch_next_(sp))
+		{
+			*n = 0;
+			return NULL;
+		}
+	}
+	StreamPrefetchBlock *b = &sp->blocks[sp->current];
+	*n = STREAM_FILE_PUSHBACK + b->length - sp->pos;
+	return b->memory + sp->pos;
+}
+
+static void stream_consume_prefetch_(struct Stream_s *stream, size_t n)
+{
+	StreamPrefetch *sp = (StreamPrefetch *)stream->ctx;
+	sp->pos += n;
+}
+
+static size_t stream_read_prefetch_(struct Stream_s *stream, void *ptr, size_t size, size_t nmemb)
+{
+	StreamPrefetch *sp = (StreamPrefetch *)stream->ctx;
+	size_t nb = size * nmemb;
+	// Most reads are a few bytes from the middle of the block
+	if(sp->holding && nb <= STREAM_FILE_PUSHBACK + sp->blocks[sp->current].length - sp->pos)
+	{
+		memcpy(ptr, sp->blocks[sp->current].memory + sp->pos, nb);
+		sp->pos += nb;
+		return nmemb;
+	}
+	size_t n = 0;
+	while(n < nb)
+	{
+		size_t avail;
+		const uint8_t *p = stream_window_prefetch_(stream, &avail);
+		if(!avail)
+			break;
+		if(avail > nb - n)
+			avail = nb - n;
+		memcpy((char *)ptr + n, p, avail);
+		stream_consume_prefetch_(stream, avail);
+		n += avail;
+	}
+	// Same as fread, a partially read element isn't counted but the position stays after it
+	return size ? n / size : 0;
+}
+
+static size_t stream_write_prefetch_(struct Stream_s *stream, const void *ptr, size_t size, size_t nmemb)
+{
+	return 0; // Read-only
+}
+
+static int stream_eof_prefetch_(struct Stream_s *stream)
+{
+	StreamPrefetch *sp = (StreamPrefetch *)stream->ctx;
+	if(!sp->holding)
+		return 0;
+	StreamPrefetchBlock *b = &sp->blocks[sp->current];
+	return b->last && sp->pos >= STREAM_FILE_PUSHBACK + b->length;
+}
+
+static int stream_name_prefetch_(struct Stream_s *s, char *buffer, size_t size)
+{
+	StreamPrefetch *sp = (StreamPrefetch *)s->ctx;
+	snprintf(buffer, size, "%s", sp->path);
+	return 0;
+}
+
+static int64_t stream_tell_prefetch_(struct Stream_s *s)
+{
+	StreamPrefetch *sp = (StreamPrefetch *)s->ctx;
+	if(!sp->holding)
+		return sp->start;
+	return sp->blocks[sp->current].offset + (int64_t)sp->pos - STREAM_FILE_PUSHBACK;
+}
+
+static int stream_seek_prefetch_(struct Stream_s *s, int64_t offset, int whence)
+{
+	StreamPrefetch *sp = (StreamPrefetch *)s->ctx;
+	switch(whence)
+	{
+		case STREAM_SEEK_CUR: offset += stream_tell_prefetch_(s); break;
+		case STREAM_SEEK_END: offset += sp->size; break;
+	}
+	if(offset < 0)
+		return 1;
+	StreamPrefetchBlock *b = &sp->blocks[sp->current];
+	// Anywhere within the current block or the bytes kept in front of it is just a matter of moving pos
+	if(sp->holding && offset >= b->offset - (int64_t)b->back && offset <= b->offset + (int64_t)b->length)
+	{
+		sp->pos = STREAM_FILE_PUSHBACK + (offset - b->offset);
+		return 0;
+	}
+	if(!sp->holding && offset == sp->start)
+		return 0;
+	stream_prefetch_restart_(sp, offset);
+	return 0;
+}
+
+static int stream_unget_prefetch_(struct Stream_s *stream, size_t n)
+{
+	StreamPrefetch *sp = (StreamPrefetch *)stream->ctx;
+	if(sp->holding && n <= sp->pos - (STREAM_FILE_PUSHBACK - sp->blocks[sp->current].back))
+	{
+		sp->pos -= n;
+		return 0;
+	}
+	int64_t position = stream_tell_prefetch_(stream) - n;
+	return position < 0 ? 1 : stream_seek_prefetch_(stream, position, STREAM_SEEK_BEG);
+}
+
+// Opens path for reading and starts the read-ahead thread, returns zero if successful.
+static int stream_open_prefetch(Stream *s, const char *path)
+{
+	FILE *fp = fopen(path, "rb");
+	if(!fp)
+		return 1;
+	StreamPrefetch *sp = calloc(1, sizeof(StreamPrefetch));
+	unsigned char *memory = malloc(2 * (STREAM_FILE_PUSHBACK + STREAM_PREFETCH_BLOCK_SIZE));
+	if(!sp || !memory)
+	{
+		free(sp);
+		free(memory);
+		fclose(fp);
+		return 1;
+	}
+	sp->fp = fp;
+	fseek(fp, 0, SEEK_END);
+	sp->size = ftell(fp);
+	fseek(fp, 0, SEEK_SET);
+	for(int i = 0; i < 2; ++i)
+		sp->blocks[i].memory = memory + i * (STREAM_FILE_PUSHBACK + STREAM_PREFETCH_BLOCK_SIZE);
+	snprintf(sp->path, sizeof(sp->path), "%s", path);
+	bool started;
+#ifdef _WIN32
+	InitializeCriticalSection(&sp->lock);
+	InitializeConditionVariable(&sp->cond);
+	sp->thread = CreateThread(NULL, 0, stream_prefetch_thread_, sp, 0, NULL);
+	started = sp->thread != NULL;
+	if(!started)
+		DeleteCriticalSection(&sp->lock);
+#else
+	pthread_mutex_init(&sp->lock, NULL);
+	pthread_cond_init(&sp->cond, NULL);
+	started = !pthread_create(&sp->thread, NULL, stream_prefetch_thread_, sp);
+	if(!started)
+	{
+		pthread_cond_destroy(&sp->cond);
+		pthread_mutex_destroy(&sp->lock);
+	}
+#endif
+	if(!started)
+	{
+		free(memory);
+		free(sp);
+		fclose(fp);
+		return 1;
+	}
+	s->ctx = sp;
+	s->flags = STREAM_FLAG_NONE;
+	s->read = stream_read_prefetch_;
+	s->write = stream_write_prefetch_;
+	s->eof = stream_eof_prefetch_;
+	s->name = stream_name_prefetch_;
+	s->tell = stream_tell_prefetch_;
+	s->seek = stream_seek_prefetch_;
+	s->window = stream_window_prefetch_;
+	s->consume = stream_consume_prefetch_;
+	s->unget = stream_unget_prefetch_;
+	s->mark = NULL;
+	s->vprintf = NULL;
+	return 0;
+}
+
+static int stream_close_prefetch(Stream *s)
+{
+	if(!s->ctx)
+	{
+		return 1;
+	}
+	StreamPrefetch *sp = s->ctx;
+	stream_prefetch_lock_(sp);
+	sp->stop = true;
+	stream_prefetch_wake_(sp);
+	stream_prefetch_unlock_(sp);
+#ifdef _WIN32
+	WaitForSingleObject(sp->thread, INFINITE);
+	CloseHandle(sp->thread);
+	DeleteCriticalSection(&sp->lock);
+#else
+	pthread_join(sp->thread, NULL);
+	pthread_cond_destroy(&sp->cond);
+	pthread_mutex_destroy(&sp->lock);
+#endif
+	fclose(sp->fp);
+	free(sp->blocks[0].memory);
+	free(sp);
+	s->ctx = NULL;
+	return 0;
+}
@@ -22,6 +22,14 @@ enum
 /* 	STREAM_RESULT_ERR, */
 /* }; */
 
+enum
+{
+	STREAM_FLAG_NONE = 0,
+	/* Text writes don't get a NUL after them. Set by backends that keep their own terminator or where one would end
+	   up in the output. */
+	STREAM_FLAG_NO_TERMINATOR = 1
+};
+
 /* typedef int32_t StreamResult; */
 typedef struct Stream_s
 {
@@ -29,6 +37,7 @@ typedef struct Stream_s
 	/* unsigned char *buffer; */
 	/* unsigned int offset, length; */
 	void *ctx;
+	uint32_t flags;
 
 	int64_t (*tell)(struct Stream_s *s);
 	/* This function returns zero if successful, or else it returns a non-zero value. */
@@ -39,8 +48,53 @@ typedef struct Stream_s
 	size_t (*read)(struct Stream_s *stream, void *ptr, size_t size, size_t nmemb);
 	/* void (*close)(struct Stream_s *stream); */
 	size_t (*write)(struct Stream_s *stream, const void *ptr, size_t size, size_t nmemb);
+
+	/* Optional, NULL if the backend doesn't support it. */
+	/* Returns the bytes from the current position that are available without copying, refilling first if there are
+	   none left, and stores how many there are in *n. *n is 0 at EOF. The pointer is valid until the next call on the
+	   stream. */
+	const uint8_t *(*window)(struct Stream_s *stream, size_t *n);
+	/* Moves the position past n bytes of the window. */
+	void (*consume)(struct Stream_s *stream, size_t n);
+	/* Moves the position back n bytes, returns zero if successful. */
+	int (*unget)(struct Stream_s *stream, size_t n);
+	/* Asks the backend to keep the bytes from position on at hand so seeking back there is cheap, -1 to release. */
+	void (*mark)(struct Stream_s *stream, int64_t position);
+	/* Formats straight into the backend's own memory, returns the number of bytes written or a negative value. */
+	int (*vprintf)(struct Stream_s *stream, const char *fmt, va_list va);
 } Stream;
 
+/* Scanning loops go through these so they run over memory when the backend has a window and fall back to one byte
+   per read when it doesn't. Returns the number of bytes at *p, 0 at EOF. Has to be followed by stream_window_used_
+   with how many of those bytes were used, the rest stay unread. */
+static size_t stream_window_(Stream *s, const uint8_t **p, uint8_t *byte)
+{
+	size_t n = 0;
+	if(s->window)
+	{
+		*p = s->window(s, &n);
+		return n;
+	}
+	*p = byte;
+	return s->read(s, byte, 1, 1) == 1 ? 1 : 0;
+}
+
+static void stream_window_used_(Stream *s, size_t used, size_t n)
+{
+	if(s->window)
+	{
+		if(used)
+			s->consume(s, used);
+	}
+	else if(used < n)
+	{
+		if(s->unget)
+			s->unget(s, 1);
+		else
+			s->seek(s, s->tell(s) - 1, STREAM_SEEK_BEG);
+	}
+}
+
 static size_t stream_read_buffer(Stream *s, void *ptr, size_t n)
 {
 	return s->read(s, ptr, n, 1);
@@ -53,21 +107,28 @@ static int stream_measure_line(Stream *s, size_t *n)
 
 	int eol = 0;
 	int eof = 0;
-	size_t offset = 0;
-	while(!eol)
+	while(!eol && !eof)
 	{
-		uint8_t ch = 0;
-		if(0 == s->read(s, &ch, 1, 1) || !ch)
+		const uint8_t *p;
+		uint8_t byte;
+		size_t avail = stream_window_(s, &p, &byte);
+		if(!avail)
 		{
 			eof = 1;
 			break;
 		}
-		switch(ch)
+		size_t i = 0;
+		for(; i < avail && !eol && !eof; ++i)
 		{
-			case '\r': eol = 1; break; // In this case, match \r as eol because we don't want carriage returns in our output.
-			case '\n': eol = 1; break;
-			default: *n += 1; break;
+			switch(p[i])
+			{
+				case 0: eof = 1; break;
+				case '\r': eol = 1; break; // In this case, match \r as eol because we don't want carriage returns in our output.
+				case '\n': eol = 1; break;
+				default: *n += 1; break;
+			}
 		}
+		stream_window_used_(s, i, avail);
 	}
 	return eof;
 }
@@ -79,33 +140,47 @@ static int stream_read_line_cr(Stream *s, char *line, size_t max_line_length, bo
 	line[n] = 0;
 
 	int eol = 0;
+	int end = 0;
 	int eof = 0;
-	size_t offset = 0;
-	while(!eol)
+	while(!eol && !end)
 	{
-		uint8_t ch = 0;
-		if(0 == s->read(s, &ch, 1, 1) || !ch)
+		const uint8_t *p;
+		uint8_t byte;
+		size_t avail = stream_window_(s, &p, &byte);
+		size_t i = 0;
+		for(; i < avail && !eol && !end; ++i)
+		{
+			uint8_t ch = p[i];
+			if(!ch)
+			{
+				end = 1;
+				break;
+			}
+			if(n + 1 >= max_line_length) // n + 1 account for \0
+			{
+				fprintf(stderr, "Error line length %d is larger than the maximum length of a line.\n", max_line_length);
+				exit(-1);
+			}
+			switch(ch)
+			{
+				case '\r': *carriage_return = true; break;
+				case '\n': eol = 1; break;
+				default:
+					*carriage_return = false;
+					line[n++] = ch;
+					break;
+			}
+		}
+		if(!avail || end)
 		{
 			// If we haven't read anything yet then this is the "real" EOF
 			// Had we encountered a \0 or EOF at the end of a line then it would have been one line too early
 			if(n == 0)
 				eof = 1;
-			break;
-		}
-		if(n + 1 >= max_line_length) // n + 1 account for \0
-		{
-			fprintf(stderr, "Error line length %d is larger than the maximum length of a line.\n", max_line_length);
-			exit(-1);
-		}
-		switch(ch)
-		{
-			case '\r': *carriage_return = true; break;
-			case '\n': eol = 1; break;
-			default:
-				*carriage_return = false;
-				line[n++] = ch;
-				break;
+			end = 1;
+			i += i < avail; // The \0 is consumed as well
 		}
+		stream_window_used_(s, i, avail);
 	}
 	line[n] = 0;
 	return eof;
@@ -117,33 +192,43 @@ static int stream_read_line(Stream *s, char *line, size_t max_line_length)
 	line[n] = 0;
 
 	int eol = 0;
+	int end = 0;
 	int eof = 0;
-	size_t offset = 0;
-	while(!eol)
+	while(!eol && !end)
 	{
-		uint8_t ch = 0;
-		if(0 == s->read(s, &ch, 1, 1) || !ch)
+		const uint8_t *p;
+		uint8_t byte;
+		size_t avail = stream_window_(s, &p, &byte);
+		size_t i = 0;
+		for(; i < avail && !eol; ++i)
+		{
+			uint8_t ch = p[i];
+			if(!ch)
+			{
+				end = 1;
+				break;
+			}
+			// Instead of stop parsing halfway through the line, just truncate the output instead
+			switch(ch)
+			{
+				case '\r': break;
+				case '\n': eol = 1; break;
+				default:
+					if(n + 1 < max_line_length) // account for \0
+						line[n++] = ch;
+				break;
+			}
+		}
+		if(!avail || end)
 		{
 			// If we haven't read anything yet then this is the "real" EOF
 			// Had we encountered a \0 or EOF at the end of a line then it would have been one line too early
 			if(n == 0)
 				eof = 1;
-			break;
-		}
-		// Instead of stop parsing halfway through the line, just truncate the output instead
-		// if(n + 1 >= max_line_length) // n + 1 account for \0
-		// {
-		// 	break;
-		// }
-		switch(ch)
-		{
-			case '\r': break;
-			case '\n': eol = 1; break;
-			default:
-				if(n + 1 < max_line_length) // account for \0
-					line[n++] = ch;
-			break;
+			end = 1;
+			i += i < avail; // The \0 is consumed as well
 		}
+		stream_window_used_(s, i, avail);
 	}
 	line[n] = 0;
 	return eof;
@@ -151,7 +236,32 @@ static int stream_read_line(Stream *s, char *line, size_t max_line_length)
 
 static void stream_unget(Stream *s)
 {
-	s->seek(s, s->tell(s) - 1, STREAM_SEEK_BEG);
+	if(s->unget)
+		s->unget(s, 1);
+	else
+		s->seek(s, s->tell(s) - 1, STREAM_SEEK_BEG);
+}
+
+/* Saves the current position to come back to with stream_restore_mark, or let go of with stream_release_mark.
+   One mark at a time, setting another one releases the previous. */
+static int64_t stream_mark(Stream *s)
+{
+	int64_t position = s->tell(s);
+	if(s->mark)
+		s->mark(s, position);
+	return position;
+}
+
+static void stream_release_mark(Stream *s)
+{
+	if(s->mark)
+		s->mark(s, -1);
+}
+
+static void stream_restore_mark(Stream *s, int64_t position)
+{
+	s->seek(s, position, STREAM_SEEK_BEG);
+	stream_release_mark(s);
 }
 
 static void steam_advance(Stream *s)
@@ -168,57 +278,103 @@ static uint8_t stream_advance(Stream *s)
 
 static uint8_t stream_current(Stream *s)
 {
+	const uint8_t *p;
 	uint8_t ch = 0;
-	if(1 == s->read(s, &ch, 1, 1))
+	size_t avail = stream_window_(s, &p, &ch);
+	stream_window_used_(s, 0, avail);
+	return avail ? p[0] : 0;
+}
+
+/* Writes length bytes of text. Unless the backend has STREAM_FLAG_NO_TERMINATOR a NUL goes after it which the next
+   write overwrites, so a buffer that's written to can be read as a string at any point. */
+static void stream_write_text(Stream *s, const char *text, size_t length)
+{
+	if(length)
+		s->write(s, text, 1, length);
+	if(!(s->flags & STREAM_FLAG_NO_TERMINATOR))
 	{
-		stream_unget(s);
+		uint8_t zero = 0;
+		if(s->write(s, &zero, 1, 1) == 1)
+			stream_unget(s);
 	}
-	return ch;
 }
 
 static void stream_print(Stream *s, const char *text)
 {
-	s->write(s, text, 1, strlen(text) + 1);
-	stream_unget(s);
+	stream_write_text(s, text, strlen(text));
 }
 
 static void stream_printf(Stream *s, const char *fmt, ...)
 {
-	char text[2048] = { 0 };
-	if(fmt)
+	if(!fmt)
+	{
+		stream_write_text(s, "", 0);
+		return;
+	}
+	va_list va;
+	va_start(va, fmt);
+	if(s->vprintf)
 	{
-		va_list va;
-		va_start(va, fmt);
-		vsnprintf(text, sizeof(text), fmt, va);
+		s->vprintf(s, fmt, va);
 		va_end(va);
+		return;
+	}
+	// Most output fits on the stack, anything longer is formatted a second time into a buffer of the right size
+	char text[2048];
+	va_list again;
+	va_copy(again, va);
+	int n = vsnprintf(text, sizeof(text), fmt, va);
+	va_end(va);
+	if(n >= (int)sizeof(text))
+	{
+		char *large = malloc(n + 1);
+		if(large)
+		{
+			vsnprintf(large, n + 1, fmt, again);
+			stream_write_text(s, large, n);
+			free(large);
+		}
+	}
+	else if(n >= 0)
+	{
+		stream_write_text(s, text, n);
 	}
-	s->write(s, text, 1, strlen(text) + 1);
-	stream_unget(s);
+	va_end(again);
 }
 
 static void stream_skip_characters(Stream *s, const char *chars)
 {
-	while(1)
+	bool skip = true;
+	while(skip)
 	{
-		uint8_t ch = 0;
-		if(0 == s->read(s, &ch, 1, 1) || !ch)
-		{
+		const uint8_t *p;
+		uint8_t byte;
+		size_t avail = stream_window_(s, &p, &byte);
+		if(!avail)
 			break;
-		}
-		bool skip = false;
-		for(size_t i = 0; chars[i]; ++i)
+		size_t i = 0;
+		for(; i < avail; ++i)
 		{
-			if(chars[i] == ch)
+			uint8_t ch = p[i];
+			if(!ch)
 			{
-				skip = true;
+				++i; // Consumed, same as reading it
+				skip = false;
 				break;
 			}
+			skip = false;
+			for(size_t k = 0; chars[k]; ++k)
+			{
+				if((uint8_t)chars[k] == ch)
+				{
+					skip = true;
+					break;
+				}
+			}
+			if(!skip)
+				break;
 		}
-		if(!skip)
-		{
-			stream_unget(s);
-			break;
-		}
+		stream_window_used_(s, i, avail);
 	}
 }
 
@@ -0,0 +1,212 @@
+#pragma once
+
+#include "stream.h"
+#include <string.h>
+#include <stdio.h>
+#include <stli/allocator.h>
+
+// Write-only stream that collects output in its own growing buffer and hands it to a sink stream in large blocks.
+// The length is kept explicitly and the buffer is always zero terminated after it, so text writes skip the trailing
+// NUL and stream_printf formats straight into the buffer. Without a sink everything stays in the buffer.
+//
+// Stream out = { 0 };
+// StreamWriter w;
+// init_stream_writer(&out, &w, &file_stream, NULL);
+// stream_printf(&out, "%s = %d;\n", name, value);
+// ...
+// stream_writer_release(&w); // Flushes whatever is left
+
+#define STREAM_WRITER_BLOCK_SIZE (64 * 1024) // Flushes to the sink once this many bytes are buffered
+
+typedef struct
+{
+	Stream *sink; // NULL to only buffer
+	char *buffer;
+	size_t length, capacity;
+	int64_t flushed; // Bytes handed to the sink so far
+	Allocator *allocator; // NULL for libc
+	bool error; // The sink or an allocation failed, further output is dropped
+} StreamWriter;
+
+// Makes room for n more bytes plus the terminator.
+static bool stream_writer_reserve_(StreamWriter *w, size_t n)
+{
+	if(w->error)
+		return false;
+	if(w->length + n < w->capacity)
+		return true;
+	size_t capacity = w->capacity ? w->capacity : 256;
+	while(w->length + n >= capacity)
+		capacity *= 2;
+	char *buffer;
+	if(w->allocator)
+		buffer = (char *)allocator_realloc(w->allocator, w->buffer, w->capacity, capacity);
+	else
+		buffer = (char *)realloc(w->buffer, capacity);
+	if(!buffer)
+	{
+		w->error = true;
+		return false;
+	}
+	w->buffer = buffer;
+	w->capacity = capacity;
+	return true;
+}
+
+static int stream_writer_flush_(StreamWriter *w)
+{
+	if(!w->sink || !w->length || w->error)
+		return w->error ? 1 : 0;
+	if(w->sink->write(w->sink, w->buffer, 1, w->length) != w->length)
+		w->error = true;
+	w->flushed += w->length;
+	w->length = 0;
+	w->buffer[0] = 0;
+	return w->error ? 1 : 0;
+}
+
+static size_t stream_write_writer_(struct Stream_s *stream, const void *ptr, size_t size, size_t nmemb)
+{
+	StreamWriter *w = (StreamWriter *)stream->ctx;
+	size_t nb = size * nmemb;
+	if(!stream_writer_reserve_(w, nb))
+		return 0;
+	memcpy(w->buffer + w->length, ptr, nb);
+	w->length += nb;
+	w->buffer[w->length] = 0;
+	if(w->length >= STREAM_WRITER_BLOCK_SIZE)
+		stream_writer_flush_(w);
+	return nmemb;
+}
+
+static int stream_vprintf_writer_(struct Stream_s *stream, const char *fmt, va_list va)
+{
+	StreamWriter *w = (StreamWriter *)stream->ctx;
+	va_list again;
+	va_copy(again, va);
+	int n = -1;
+	if(stream_writer_reserve_(w, 0))
+	{
+		// First try whatever room is left, if it didn't fit the buffer grows and it's formatted again
+		size_t room = w->capacity - w->length;
+		n = vsnprintf(w->buffer + w->length, room, fmt, va);
+		if(n >= 0 && (size_t)n >= room)
+			n = stream_writer_reserve_(w, n) ? vsnprintf(w->buffer + w->length, n + 1, fmt, again) : -1;
+	}
+	va_end(again);
+	if(n < 0)
+	{
+		if(w->buffer)
+			w->buffer[w->length] = 0;
+		return n;
+	}
+	w->length += n;
+	if(w->length >= STREAM_WRITER_BLOCK_SIZE)
+		stream_writer_flush_(w);
+	return n;
+}
+
+static size_t stream_read_writer_(struct Stream_s *stream, void *ptr, size_t size, size_t nmemb)
+{
+	return 0; // Write-only
+}
+
+static int stream_eof_writer_(struct Stream_s *stream)
+{
+	return 1;
+}
+
+static int stream_name_writer_(struct Stream_s *s, char *buffer, size_t size)
+{
+	StreamWriter *w = (StreamWriter *)s->ctx;
+	if(w->sink)
+		return w->sink->name(w->sink, buffer, size);
+	buffer[0] = 0;
+	return 0;
+}
+
+static int64_t stream_tell_writer_(struct Stream_s *s)
+{
+	StreamWriter *w = (StreamWriter *)s->ctx;
+	return w->flushed + w->length;
+}
+
+// Only within what hasn't been flushed yet, moving back drops everything written after the new position.
+static int stream_seek_writer_(struct Stream_s *s, int64_t offset, int whence)
+{
+	StreamWriter *w = (StreamWriter *)s->ctx;
+	int64_t current = 0;
+	switch(whence)
+	{
+		case STREAM_SEEK_BEG: current = 0; break;
+		case STREAM_SEEK_CUR:
+		case STREAM_SEEK_END: current = w->flushed + w->length; break;
+	}
+	current += offset;
+	if(current < w->flushed || current > w->flushed + (int64_t)w->length)
+		return 1;
+	w->length = current - w->flushed;
+	if(w->buffer)
+		w->buffer[w->length] = 0;
+	return 0;
+}
+
+static int stream_unget_writer_(struct Stream_s *s, size_t n)
+{
+	StreamWriter *w = (StreamWriter *)s->ctx;
+	if(n > w->length)
+		return 1;
+	w->length -= n;
+	w->buffer[w->length] = 0;
+	return 0;
+}
+
+// The buffer grows through a, or libc when it's NULL.
+static int init_stream_writer(Stream *s, StreamWriter *w, Stream *sink, Allocator *a)
+{
+	memset(w, 0, sizeof(StreamWriter));
+	w->sink = sink;
+	w->allocator = a;
+
+	s->ctx = w;
+	s->flags = STREAM_FLAG_NO_TERMINATOR;
+	s->read = stream_read_writer_;
+	s->write = stream_write_writer_;
+	s->eof = stream_eof_writer_;
+	s->name = stream_name_writer_;
+	s->tell = stream_tell_writer_;
+	s->seek = stream_seek_writer_;
+	s->window = NULL;
+	s->consume = NULL;
+	s->unget = stream_unget_writer_;
+	s->mark = NULL;
+	s->vprintf = stream_vprintf_writer_;
+	return 0;
+}
+
+// Hands everything buffered to the sink, returns zero if all output so far made it there.
+static int stream_writer_flush(Stream *s)
+{
+	return stream_writer_flush_((StreamWriter *)s->ctx);
+}
+
+// What's buffered and not flushed yet, zero terminated. Without a sink that's all of the output.
+static const char *stream_writer_text(StreamWriter *w, size_t *length)
+{
+	if(length)
+		*length = w->length;
+	return w->buffer ? w->buffer : "";
+}
+
+// Flushes and frees the buffer, returns zero if all output made it to the sink.
+static int stream_writer_release(StreamWriter *w)
+{
+	int result = stream_writer_flush_(w);
+	if(w->buffer && w->allocator)
+		w->allocator->free(w->allocator->ctx, w->buffer);
+	else
+		free(w->buffer);
+	w->buffer = NULL;
+	w->length = w->capacity = 0;
+	return result;
+}
@@ -1,8 +1,15 @@
 #pragma once
 #include <stddef.h>
+#include <string.h>
 
 // https://nullprogram.com/blog/2023/12/17/
 
+enum
+{
+	ALLOCATOR_FLAG_NONE = 0,
+	ALLOCATOR_FLAG_ZEROED = 1 // malloc always returns zeroed memory, callers can skip clearing it themselves
+};
+
 // typedef struct
 // {
 // 	void *ptr;
@@ -18,8 +25,25 @@ typedef struct
 	// I prefer having two seperate functions
 	// void *lua_Alloc(void *ctx, void *ptr, size_t old, size_t new);
 	void *ctx;
+
+	// Optional, use allocator_realloc which falls back to malloc + memcpy + free when this is NULL.
+	// ptr may be NULL in which case old_size is 0.
+	void *(*realloc)(void *ctx, void *ptr, size_t old_size, size_t new_size);
+	int flags;
 } Allocator;
 
+static void *allocator_realloc(Allocator *a, void *ptr, size_t old_size, size_t new_size)
+{
+	if(a->realloc)
+		return a->realloc(a->ctx, ptr, old_size, new_size);
+	void *p = a->malloc(a->ctx, new_size);
+	if(!p || !ptr)
+		return p;
+	memcpy(p, ptr, old_size < new_size ? old_size : new_size);
+	a->free(a->ctx, ptr);
+	return p;
+}
+
 #ifdef ALLOCATOR_MALLOC_WRAPPER
 #include <malloc.h>
 static void *allocator_malloc_(void *ctx, size_t size)
@@ -30,5 +54,9 @@ static void allocator_free_(void *ctx, void *ptr)
 {
 	free(ptr);
 }
-static Allocator malloc_allocator = { allocator_malloc_, allocator_free_, 0 };
+static void *allocator_realloc_(void *ctx, void *ptr, size_t old_size, size_t new_size)
+{
+	return realloc(ptr, new_size);
+}
+static Allocator malloc_allocator = { allocator_malloc_, allocator_free_, 0, allocator_realloc_ };
 #endif
\ No newline at end of file
@@ -0,0 +1,229 @@
+#pragma once
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <stli/allocator.h>
+#include <stli/arena.h>
+
+// Allocator that forwards to another allocator and keeps count of what goes through it.
+// Allocations are attributed to the callsite last marked with ALLOCATOR_HERE, e.g.
+//
+// hash_trie_upsert(&trie, key, ALLOCATOR_HERE(&stats_allocator), true);
+//
+// The mark sticks until the next ALLOCATOR_HERE, allocations made before any mark are reported as unknown.
+// Every allocation is prefixed with a small header holding its size so free can track the live byte count.
+
+#define ALLOCATOR_STATS_MAX_CALLSITES (256)
+#define ALLOCATOR_STATS_BUCKETS (32) // Size histogram, bucket i counts allocations of [2^(i-1), 2^i) bytes
+
+typedef struct
+{
+	const char *file;
+	int line;
+	size_t count;
+	size_t bytes;
+	size_t histogram[ALLOCATOR_STATS_BUCKETS];
+} AllocatorCallsite;
+
+typedef struct
+{
+	Allocator *inner;
+	Arena *arena; // Optional, to report how full it is
+	char *arena_beg;
+
+	const char *file;
+	int line;
+
+	size_t mallocs, frees, reallocs;
+	size_t bytes_total, bytes_live, bytes_peak;
+	size_t callsite_count;
+	AllocatorCallsite callsites[ALLOCATOR_STATS_MAX_CALLSITES];
+	AllocatorCallsite overflow; // Callsites that didn't fit in the table
+} AllocatorStats;
+
+typedef union
+{
+	size_t size;
+	max_align_t align_;
+} AllocatorStatsHeader;
+
+static void *allocator_stats_malloc_(void *ctx, size_t size);
+
+static Allocator *allocator_stats_here_(Allocator *a, const char *file, int line)
+{
+	if(a && a->malloc == allocator_stats_malloc_)
+	{
+		AllocatorStats *stats = (AllocatorStats *)a->ctx;
+		stats->file = file;
+		stats->line = line;
+	}
+	return a;
+}
+#define ALLOCATOR_HERE(a) allocator_stats_here_((a), __FILE__, __LINE__)
+
+static AllocatorCallsite *allocator_stats_callsite_(AllocatorStats *stats)
+{
+	uint64_t h = ((uintptr_t)stats->file ^ (uint64_t)stats->line * 1111111111111111111u) * 1111111111111111111u;
+	size_t mask = ALLOCATOR_STATS_MAX_CALLSITES - 1;
+	for(size_t i = 0, k = h >> 32; i <= mask; ++i, ++k)
+	{
+		AllocatorCallsite *cs = &stats->callsites[k & mask];
+		if(!cs->count)
+		{
+			cs->file = stats->file;
+			cs->line = stats->line;
+			stats->callsite_count++;
+			return cs;
+		}
+		if(cs->file == stats->file && cs->line == stats->line)
+			return cs;
+	}
+	return &stats->overflow;
+}
+
+static void allocator_stats_record_(AllocatorStats *stats, size_t size)
+{
+	AllocatorCallsite *cs = allocator_stats_callsite_(stats);
+	size_t bucket = 0;
+	while(bucket < ALLOCATOR_STATS_BUCKETS - 1 && ((size_t)1 << bucket) <= size)
+		++bucket;
+	cs->count++;
+	cs->bytes += size;
+	cs->histogram[bucket]++;
+	stats->bytes_total += size;
+	stats->bytes_live += size;
+	if(stats->bytes_live > stats->bytes_peak)
+		stats->bytes_peak = stats->bytes_live;
+}
+
+static void *allocator_stats_malloc_(void *ctx, size_t size)
+{
+	AllocatorStats *stats = (AllocatorStats *)ctx;
+	AllocatorStatsHeader *hdr = (AllocatorStatsHeader *)stats->inner->malloc(stats->inner->ctx, sizeof(AllocatorStatsHeader) + size);
+	if(!hdr)
+		return NULL;
+	hdr->size = size;
+	stats->mallocs++;
+	allocator_stats_record_(stats, size);
+	return hdr + 1;
+}
+
+static void allocator_stats_free_(void *ctx, void *ptr)
+{
+	AllocatorStats *stats = (AllocatorStats *)ctx;
+	if(!ptr)
+		return;
+	AllocatorStatsHeader *hdr = (AllocatorStatsHeader *)ptr - 1;
+	stats->frees++;
+	stats->bytes_live -= hdr->size;
+	stats->inner->free(stats->inner->ctx, hdr);
+}
+
+static void *allocator_stats_realloc_(void *ctx, void *ptr, size_t old_size, size_t new_size)
+{
+	AllocatorStats *stats = (AllocatorStats *)ctx;
+	if(!ptr)
+		return allocator_stats_malloc_(ctx, new_size);
+	AllocatorStatsHeader *hdr = (AllocatorStatsHeader *)ptr - 1;
+	size_t size = hdr->size;
+	hdr = (AllocatorStatsHeader *)allocator_realloc(
+		stats->inner, hdr, sizeof(AllocatorStatsHeader) + size, sizeof(AllocatorStatsHeader) + new_size);
+	if(!hdr)
+		return NULL;
+	hdr->size = new_size;
+	stats->reallocs++;
+	stats->bytes_live -= size;
+	allocator_stats_record_(stats, new_size);
+	return hdr + 1;
+}
+
+// arena is optional, its fill ratio is measured from where beg is at this point.
+static void allocator_stats_init(AllocatorStats *stats, Allocator *inner, Arena *arena)
+{
+	memset(stats, 0, sizeof(AllocatorStats));
+	stats->inner = inner;
+	stats->arena = arena;
+	stats->arena_beg = arena ? arena->beg : NULL;
+}
+
+static Allocator allocator_stats_allocator(AllocatorStats *stats)
+{
+	return (Allocator) {
+		allocator_stats_malloc_, allocator_stats_free_, stats, allocator_stats_realloc_, stats->inner->flags
+	};
+}
+
+// Bytes used and available in an arena, chained arenas count every block and treat the unused tails of old blocks
+// as used since they can't be allocated from anymore.
+static void allocator_stats_arena_usage(Arena *a, char *beg, size_t *used, size_t *capacity)
+{
+	*used = 0;
+	*capacity = 0;
+	if(a->block)
+	{
+		for(ArenaBlock *block = a->block; block; block = block->prev)
+			*capacity += block->end - (char *)(block + 1);
+		*used = *capacity - (a->end - a->beg);
+	}
+	else if(a->reserve_beg)
+	{
+		*used = a->beg - a->reserve_beg;
+		*capacity = a->reserve_end - a->reserve_beg;
+	}
+	else if(beg)
+	{
+		*used = a->beg - beg;
+		*capacity = a->end - beg;
+	}
+}
+
+static int allocator_stats_cmp_(const void *a, const void *b)
+{
+	const AllocatorCallsite *x = *(const AllocatorCallsite **)a;
+	const AllocatorCallsite *y = *(const AllocatorCallsite **)b;
+	return x->bytes < y->bytes ? 1 : x->bytes > y->bytes ? -1 : 0;
+}
+
+static void allocator_stats_print(AllocatorStats *stats, FILE *out)
+{
+	fprintf(out, "allocations: %zu, frees: %zu, reallocs: %zu\n", stats->mallocs, stats->frees, stats->reallocs);
+	fprintf(out, "bytes total: %zu, live: %zu, peak: %zu\n", stats->bytes_total, stats->bytes_live, stats->bytes_peak);
+	if(stats->arena)
+	{
+		size_t used, capacity;
+		allocator_stats_arena_usage(stats->arena, stats->arena_beg, &used, &capacity);
+		fprintf(out, "arena: %zu / %zu bytes (%.1f%%)\n", used, capacity, capacity ? 100.0 * used / capacity : 0.0);
+	}
+
+	AllocatorCallsite *sorted[ALLOCATOR_STATS_MAX_CALLSITES + 1];
+	size_t n = 0;
+	for(size_t i = 0; i < ALLOCATOR_STATS_MAX_CALLSITES; ++i)
+	{
+		if(stats->callsites[i].count)
+			sorted[n++] = &stats->callsites[i];
+	}
+	if(stats->overflow.count)
+		sorted[n++] = &stats->overflow;
+	qsort(sorted, n, sizeof(sorted[0]), allocator_stats_cmp_);
+
+	for(size_t i = 0; i < n; ++i)
+	{
+		AllocatorCallsite *cs = sorted[i];
+		if(cs == &stats->overflow)
+			fprintf(out, "(other)");
+		else if(cs->file)
+			fprintf(out, "%s:%d", cs->file, cs->line);
+		else
+			fprintf(out, "(unknown)");
+		fprintf(out, ": %zu allocations, %zu bytes\n", cs->count, cs->bytes);
+		for(size_t k = 0; k < ALLOCATOR_STATS_BUCKETS; ++k)
+		{
+			if(!cs->histogram[k])
+				continue;
+			fprintf(out, "\t%zu-%zu: %zu\n", k ? (size_t)1 << (k - 1) : 0, ((size_t)1 << k) - 1, cs->histogram[k]);
+		}
+	}
+}
@@ -9,31 +9,76 @@
 #include <stdlib.h>
 #include <stli/allocator.h>
 
-typedef struct
+typedef struct ArenaBlock ArenaBlock;
+typedef struct Arena Arena;
+
+// Header placed at the start of every block a chained arena gets from its backing allocator.
+struct ArenaBlock
+{
+	ArenaBlock *prev;
+	char *end;
+};
+
+struct Arena
 {
 	char *beg;
 	char *end;
 	jmp_buf *jmp_oom;
-} Arena;
 
-static void *arena_allocate_memory_(Arena *a, ptrdiff_t size, ptrdiff_t align, ptrdiff_t count)
+	// Called when the current window can't fit an allocation, NULL for a fixed arena.
+	// Should make room for at least size bytes at the given alignment and return false if it can't.
+	bool (*grow)(Arena *a, ptrdiff_t size, ptrdiff_t align);
+
+	// Chained arenas
+	ArenaBlock *block;
+	Allocator *backing;
+	ptrdiff_t block_size; // Minimum size of the next block, commit granularity for virtual arenas
+	int growth; // block_size is multiplied by this after every new block, 1 keeps it constant
+
+	// Virtual arenas, see stli/virtual_arena.h
+	char *reserve_beg;
+	char *reserve_end;
+};
+
+typedef struct
+{
+	ArenaBlock *block;
+	char *beg;
+	char *end;
+} ArenaCheckpoint;
+
+enum
+{
+	ARENA_FLAG_NONE = 0,
+	ARENA_FLAG_NO_ZERO = 1 // Leave the memory uninitialized, for buffers that are about to be overwritten anyway
+};
+
+static void *arena_allocate_memory_(Arena *a, ptrdiff_t size, ptrdiff_t align, ptrdiff_t count, int flags)
 {
 	ptrdiff_t padding = -(uintptr_t)a->beg & (align - 1);
 	ptrdiff_t available = a->end - a->beg - padding;
 	if(available < 0 || count > available / size)
 	{
-		if(a->jmp_oom)
-			longjmp(*a->jmp_oom, 1);
-		return NULL;
+		if(!a->grow || count > (PTRDIFF_MAX - align) / size || !a->grow(a, count * size, align))
+		{
+			if(a->jmp_oom)
+				longjmp(*a->jmp_oom, 1);
+			return NULL;
+		}
+		padding = -(uintptr_t)a->beg & (align - 1);
 	}
 	void *p = a->beg + padding;
 	a->beg += padding + count * size;
+	if(flags & ARENA_FLAG_NO_ZERO)
+		return p;
 	return memset(p, 0, count * size);
 }
-#define new(a, t, n) (t *)arena_allocate_memory_(a, sizeof(t), _Alignof(t), n)
+#define new(a, t, n) (t *)arena_allocate_memory_(a, sizeof(t), _Alignof(t), n, ARENA_FLAG_NONE)
+#define new_uninit(a, t, n) (t *)arena_allocate_memory_(a, sizeof(t), _Alignof(t), n, ARENA_FLAG_NO_ZERO)
 
 static void arena_init(Arena *a, char *buffer, size_t size)
 {
+	memset(a, 0, sizeof(Arena));
 	a->beg = buffer;
 	a->end = buffer + size;
 	a->jmp_oom = NULL;
@@ -44,26 +89,141 @@ static void arena_init(Arena *a, char *buffer, size_t size)
 	// }
 }
 
+static bool arena_grow_chained_(Arena *a, ptrdiff_t size, ptrdiff_t align)
+{
+	ptrdiff_t header = sizeof(ArenaBlock);
+	ptrdiff_t need = header + size + align;
+	if(size > PTRDIFF_MAX - header - align)
+		return false;
+	ptrdiff_t n = a->block_size > need ? a->block_size : need;
+	ArenaBlock *block = (ArenaBlock *)a->backing->malloc(a->backing->ctx, n);
+	if(!block)
+		return false;
+	block->prev = a->block;
+	block->end = (char *)block + n;
+	a->block = block;
+	a->beg = (char *)(block + 1);
+	a->end = block->end;
+	if(a->growth > 1 && a->block_size <= PTRDIFF_MAX / a->growth)
+		a->block_size *= a->growth;
+	return true;
+}
+
+// Arena that requests blocks of at least block_size bytes from backing whenever it runs out, it never fails unless
+// backing does. No memory is requested until the first allocation.
+static void arena_init_chained(Arena *a, Allocator *backing, size_t block_size, int growth)
+{
+	arena_init(a, NULL, 0);
+	a->grow = arena_grow_chained_;
+	a->backing = backing;
+	a->block_size = block_size;
+	a->growth = growth < 1 ? 1 : growth;
+}
+
+static ArenaCheckpoint arena_save(Arena *a)
+{
+	return (ArenaCheckpoint) { a->block, a->beg, a->end };
+}
+
+// Releases everything allocated after the checkpoint was taken, blocks that were chained since then are given back
+// to the backing allocator.
+static void arena_restore(Arena *a, ArenaCheckpoint cp)
+{
+	if(a->block != cp.block)
+	{
+		while(a->block && a->block != cp.block)
+		{
+			ArenaBlock *prev = a->block->prev;
+			a->backing->free(a->backing->ctx, a->block);
+			a->block = prev;
+		}
+		a->end = cp.end;
+	}
+	a->beg = cp.beg;
+}
+
+// Rewinds to the state right after initialization while keeping the first block around for reuse.
+static void arena_reset(Arena *a)
+{
+	if(!a->block)
+		return;
+	while(a->block->prev)
+	{
+		ArenaBlock *prev = a->block->prev;
+		a->backing->free(a->backing->ctx, a->block);
+		a->block = prev;
+	}
+	a->beg = (char *)(a->block + 1);
+	a->end = a->block->end;
+}
+
+// Frees all blocks of a chained arena, a no-op for fixed arenas.
+static void arena_release(Arena *a)
+{
+	if(a->block)
+		arena_restore(a, (ArenaCheckpoint) { NULL, NULL, NULL });
+}
+
 static Arena arena_split(Arena *base, int size)
 {
 	Arena a = {0};
-	arena_init(&a, base->beg, size);
-	base->beg += size;
+	char *p = new_uninit(base, char, size);
+	arena_init(&a, p, p ? size : 0);
 	a.jmp_oom = base->jmp_oom;
 	return a;
 }
 
+// Allocator users don't know what they're storing, so align like malloc would.
 static void *arena_malloc_(void *ctx, size_t size)
 {
 	Arena *arena = (Arena*)ctx;
-	return new(arena, char, size);
+	return arena_allocate_memory_(arena, 1, _Alignof(max_align_t), size, ARENA_FLAG_NONE);
+}
+
+static void *arena_malloc_uninit_(void *ctx, size_t size)
+{
+	Arena *arena = (Arena*)ctx;
+	return arena_allocate_memory_(arena, 1, _Alignof(max_align_t), size, ARENA_FLAG_NO_ZERO);
 }
 
 static void arena_free_(void *ctx, void *ptr)
 {
 }
 
+// Resizes the most recent allocation in place when it ends at beg, otherwise copies into a new allocation.
+// Bytes past old_size are not zeroed when growing in place.
+static void *arena_realloc(Arena *a, void *ptr, size_t old_size, size_t new_size)
+{
+	char *p = (char *)ptr;
+	if(p && p + old_size == a->beg)
+	{
+		size_t extra = new_size > old_size ? new_size - old_size : 0;
+		// Virtual arenas grow by committing past end, so the tail allocation can keep growing where it is
+		if(extra <= (size_t)(a->end - a->beg)
+			|| (a->reserve_end && a->grow && extra <= PTRDIFF_MAX && a->grow(a, (ptrdiff_t)extra, 1)))
+		{
+			a->beg = p + new_size;
+			return p;
+		}
+	}
+	char *q = (char *)arena_allocate_memory_(a, 1, _Alignof(max_align_t), new_size, ARENA_FLAG_NO_ZERO);
+	if(q && p)
+		memcpy(q, p, old_size < new_size ? old_size : new_size);
+	return q;
+}
+
+static void *arena_realloc_(void *ctx, void *ptr, size_t old_size, size_t new_size)
+{
+	return arena_realloc((Arena *)ctx, ptr, old_size, new_size);
+}
+
 static Allocator arena_allocator(Arena *arena)
 {
-	return (Allocator) { arena_malloc_, arena_free_, arena };
+	return (Allocator) { arena_malloc_, arena_free_, arena, arena_realloc_, ALLOCATOR_FLAG_ZEROED };
+}
+
+// Same as arena_allocator but malloc skips zeroing the memory.
+static Allocator arena_allocator_uninit(Arena *arena)
+{
+	return (Allocator) { arena_malloc_uninit_, arena_free_, arena, arena_realloc_, ALLOCATOR_FLAG_NONE };
 }
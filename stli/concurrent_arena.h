@@ -0,0 +1,87 @@
+#pragma once
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+#include <stli/allocator.h>
+#include <stli/arena.h>
+
+// Bump allocator that can be shared between threads, allocating is a single atomic fetch-add on the offset.
+// For hot paths every thread should set up a local arena with concurrent_arena_local, which grabs chunks from the
+// shared arena and bump allocates from them without touching shared state until the chunk is used up.
+
+typedef struct
+{
+	char *base;
+	ptrdiff_t capacity;
+	ptrdiff_t offset; // Only accessed atomically, can overshoot capacity once the arena is exhausted
+
+	Allocator chunk_allocator; // Backing allocator for local arenas
+} ConcurrentArena;
+
+// Thread-safe, returns uninitialized memory or NULL when the arena is exhausted.
+static void *concurrent_arena_allocate(ConcurrentArena *ca, ptrdiff_t size, ptrdiff_t align)
+{
+	if(size < 0 || size > ca->capacity)
+		return NULL;
+	// Reserve enough for the worst case padding so the alignment can be applied after the fact
+	ptrdiff_t n = size + align - 1;
+	// Check first so a request that can never fit doesn't push the offset past the end for everyone else
+	if(__atomic_load_n(&ca->offset, __ATOMIC_RELAXED) > ca->capacity - n)
+		return NULL;
+	ptrdiff_t offset = __atomic_fetch_add(&ca->offset, n, __ATOMIC_RELAXED);
+	if(offset > ca->capacity - n)
+		return NULL;
+	char *p = ca->base + offset;
+	return p + (-(uintptr_t)p & (align - 1));
+}
+
+static void *concurrent_arena_malloc_uninit_(void *ctx, size_t size)
+{
+	return concurrent_arena_allocate((ConcurrentArena *)ctx, size, _Alignof(max_align_t));
+}
+
+static void *concurrent_arena_malloc_(void *ctx, size_t size)
+{
+	void *p = concurrent_arena_allocate((ConcurrentArena *)ctx, size, _Alignof(max_align_t));
+	return p ? memset(p, 0, size) : NULL;
+}
+
+static void concurrent_arena_free_(void *ctx, void *ptr)
+{
+}
+
+static void concurrent_arena_init(ConcurrentArena *ca, char *buffer, size_t size)
+{
+	ca->base = buffer;
+	ca->capacity = size;
+	ca->offset = 0;
+	ca->chunk_allocator = (Allocator) { concurrent_arena_malloc_uninit_, concurrent_arena_free_, ca };
+}
+
+// Not thread-safe, no other thread may be allocating from the arena or any of its local arenas.
+static void concurrent_arena_reset(ConcurrentArena *ca)
+{
+	__atomic_store_n(&ca->offset, 0, __ATOMIC_RELAXED);
+}
+
+// Bytes handed out so far, including padding and the unused tails of local arena chunks.
+static ptrdiff_t concurrent_arena_used(ConcurrentArena *ca)
+{
+	ptrdiff_t offset = __atomic_load_n(&ca->offset, __ATOMIC_RELAXED);
+	return offset < ca->capacity ? offset : ca->capacity;
+}
+
+// Per-thread arena that takes chunk_size bytes at a time from the shared arena. The local arena itself must only be
+// used by one thread, but any number of them can draw from the same shared arena.
+static void concurrent_arena_local(Arena *local, ConcurrentArena *shared, size_t chunk_size)
+{
+	arena_init_chained(local, &shared->chunk_allocator, chunk_size, 1);
+}
+
+// Thread-safe Allocator that goes straight to the shared arena, malloc returns zeroed memory.
+static Allocator concurrent_arena_allocator(ConcurrentArena *ca)
+{
+	return (Allocator) { concurrent_arena_malloc_, concurrent_arena_free_, ca, NULL, ALLOCATOR_FLAG_ZEROED };
+}
@@ -2,8 +2,11 @@
 
 // https://en.wikipedia.org/wiki/Fowler%E2%80%93Noll%E2%80%93Vo_hash_function
 
+#include <stdbool.h>
+#include <stddef.h>
 #include <stdint.h>
 #include <stdio.h>
+#include <string.h>
 #include <assert.h>
 #include <ctype.h>
 
@@ -37,6 +40,21 @@ static uint64_t fnv1a_64(const char *str)
 	return hash;
 }
 
+// Lowercases ASCII letters without going through the locale, other bytes are left alone.
+static unsigned char ascii_tolower(unsigned char c)
+{
+	return c | ((unsigned char)(c - 'A') < 26) << 5;
+}
+
+// Same as ascii_tolower but for all 8 bytes of a word at once.
+// For each byte, adding 0x3f sets the top bit from 'A' upwards and adding 0x25 sets it past 'Z'.
+static uint64_t ascii_tolower64(uint64_t w)
+{
+	uint64_t a = w & 0x7f7f7f7f7f7f7f7full;
+	uint64_t upper = ((a + 0x3f3f3f3f3f3f3f3full) ^ (a + 0x2525252525252525ull)) & ~w & 0x8080808080808080ull;
+	return w | upper >> 2;
+}
+
 static uint64_t fnv1a_64_lc(const char *str)
 {
 	uint64_t prime = 0x00000100000001B3;
@@ -45,7 +63,7 @@ static uint64_t fnv1a_64_lc(const char *str)
 	uint64_t hash = offset;
 	while(*str)
 	{
-		hash ^= (unsigned char)tolower(*str);
+		hash ^= ascii_tolower(*str);
 		hash *= prime;
 		++str;
 	}
@@ -82,6 +100,250 @@ static uint64_t fnv1a_64_range(const char *beg, const char *end)
 	return hash;
 }
 
+// Word-at-a-time hash in the style of wyhash, every multiply consumes 16 bytes of input.
+// Words are read in native byte order, so hashes differ between little and big endian machines.
+
+static const uint64_t hash64_secret_[4] = {
+	0xa0761d6478bd642full, 0xe7037ed1a0b428dbull, 0x8ebc6af09c88c6e3ull, 0x589965cc75374cc3ull
+};
+
+static uint64_t hash64_mix_(uint64_t a, uint64_t b)
+{
+#ifdef __SIZEOF_INT128__
+	__uint128_t r = (__uint128_t)a * b;
+	return (uint64_t)r ^ (uint64_t)(r >> 64);
+#else
+	uint64_t ha = a >> 32, la = (uint32_t)a, hb = b >> 32, lb = (uint32_t)b;
+	uint64_t rh = ha * hb, rm0 = ha * lb, rm1 = hb * la, rl = la * lb;
+	uint64_t t = rl + (rm0 << 32);
+	uint64_t c = t < rl;
+	uint64_t lo = t + (rm1 << 32);
+	c += lo < t;
+	uint64_t hi = rh + (rm0 >> 32) + (rm1 >> 32) + c;
+	return lo ^ hi;
+#endif
+}
+
+// Reads n <= 8 bytes into a zero padded word, same as memcpy into a zeroed uint64_t but without calling memcpy for
+// variable sizes.
+static uint64_t hash64_read_(const unsigned char *p, size_t n)
+{
+	uint64_t v = 0;
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+	uint32_t lo, hi;
+	if(n == 8)
+	{
+		memcpy(&v, p, 8);
+	}
+	else if(n >= 4)
+	{
+		memcpy(&lo, p, 4);
+		memcpy(&hi, p + n - 4, 4);
+		v = lo | ((uint64_t)hi >> (8 * (8 - n))) << 32;
+	}
+	else if(n > 0)
+	{
+		v = p[0] | (uint64_t)p[n / 2] << (8 * (n / 2)) | (uint64_t)p[n - 1] << (8 * (n - 1));
+	}
+#else
+	memcpy(&v, p, n);
+#endif
+	return v;
+}
+
+static uint64_t hash64_block_(uint64_t seed, const unsigned char *p)
+{
+	return hash64_mix_(hash64_read_(p, 8) ^ hash64_secret_[1], hash64_read_(p + 8, 8) ^ seed);
+}
+
+// Hashes the last 0 to 16 bytes
+static uint64_t hash64_final_(uint64_t seed, const unsigned char *tail, size_t n, uint64_t length)
+{
+	uint64_t a = hash64_read_(tail, n > 8 ? 8 : n);
+	uint64_t b = n > 8 ? hash64_read_(tail + 8, n - 8) : 0;
+	uint64_t h = hash64_mix_(a ^ hash64_secret_[1], b ^ seed);
+	return hash64_mix_(h ^ hash64_secret_[2], length ^ hash64_secret_[3]);
+}
+
+static uint64_t hash64_seeded(const void *data, size_t n, uint64_t seed)
+{
+	const unsigned char *p = (const unsigned char *)data;
+	uint64_t length = n;
+	seed ^= hash64_secret_[0];
+	for(; n > 16; n -= 16, p += 16)
+		seed = hash64_block_(seed, p);
+	return hash64_final_(seed, p, n, length);
+}
+
+static uint64_t hash64(const void *data, size_t n)
+{
+	return hash64_seeded(data, n, 0);
+}
+
+// Hash of the data with ASCII letters lowercased, same as calling hash64 on a lowercased copy.
+static uint64_t hash64_lc(const void *data, size_t n)
+{
+	const unsigned char *p = (const unsigned char *)data;
+	uint64_t length = n;
+	uint64_t seed = hash64_secret_[0];
+	for(; n > 16; n -= 16, p += 16)
+	{
+		uint64_t a = ascii_tolower64(hash64_read_(p, 8));
+		uint64_t b = ascii_tolower64(hash64_read_(p + 8, 8));
+		seed = hash64_mix_(a ^ hash64_secret_[1], b ^ seed);
+	}
+	unsigned char tail[16];
+	uint64_t a = ascii_tolower64(hash64_read_(p, n > 8 ? 8 : n));
+	uint64_t b = n > 8 ? ascii_tolower64(hash64_read_(p + 8, n - 8)) : 0;
+	memcpy(tail, &a, 8);
+	memcpy(tail + 8, &b, 8);
+	return hash64_final_(seed, tail, n, length);
+}
+
+// Incremental version of hash64, feeding the same bytes in any number of pieces gives the same hash.
+typedef struct
+{
+	uint64_t seed;
+	uint64_t length;
+	size_t buffered;
+	unsigned char buffer[16];
+} Hash64State;
+
+static void hash64_init(Hash64State *s, uint64_t seed)
+{
+	s->seed = seed ^ hash64_secret_[0];
+	s->length = 0;
+	s->buffered = 0;
+}
+
+// A full block is only consumed once more input arrives, the final block is handled by hash64_final_.
+static void hash64_update_byte(Hash64State *s, unsigned char ch)
+{
+	if(s->buffered == 16)
+	{
+		s->seed = hash64_block_(s->seed, s->buffer);
+		s->buffered = 0;
+	}
+	s->buffer[s->buffered++] = ch;
+	s->length++;
+}
+
+static void hash64_update(Hash64State *s, const void *data, size_t n)
+{
+	const unsigned char *p = (const unsigned char *)data;
+	while(n > 0 && s->buffered < 16)
+	{
+		s->buffer[s->buffered++] = *p++;
+		s->length++;
+		n--;
+	}
+	if(n == 0)
+		return;
+	s->seed = hash64_block_(s->seed, s->buffer);
+	s->length += n;
+	for(; n > 16; n -= 16, p += 16)
+		s->seed = hash64_block_(s->seed, p);
+	memcpy(s->buffer, p, n);
+	s->buffered = n;
+}
+
+static uint64_t hash64_final(Hash64State *s)
+{
+	return hash64_final_(s->seed, s->buffer, s->buffered, s->length);
+}
+
+// The hash shared by the lexer, hash trie and JSON objects. Defaults to hash64, define STLI_HASH_FNV to use FNV-1a.
+// HASH_BYTES_ID identifies the selection in anything that stores hashes, e.g. hash trie images.
+#ifdef STLI_HASH_FNV
+#define HASH_BYTES_ID (2)
+typedef uint64_t HashState;
+static void hash_state_init(HashState *s)
+{
+	*s = 0xcbf29ce484222325;
+}
+static void hash_state_byte(HashState *s, unsigned char ch)
+{
+	*s ^= ch;
+	*s *= 0x00000100000001B3;
+}
+static void hash_state_update(HashState *s, const void *data, size_t n)
+{
+	for(size_t i = 0; i < n; ++i)
+		hash_state_byte(s, ((const unsigned char *)data)[i]);
+}
+static uint64_t hash_state_final(HashState *s)
+{
+	return *s;
+}
+static uint64_t hash_bytes(const void *data, size_t n)
+{
+	HashState s;
+	hash_state_init(&s);
+	hash_state_update(&s, data, n);
+	return s;
+}
+static uint64_t hash_bytes_lc(const void *data, size_t n)
+{
+	HashState s;
+	hash_state_init(&s);
+	for(size_t i = 0; i < n; ++i)
+		hash_state_byte(&s, ascii_tolower(((const unsigned char *)data)[i]));
+	return s;
+}
+#else
+#define HASH_BYTES_ID (1)
+typedef Hash64State HashState;
+static void hash_state_init(HashState *s)
+{
+	hash64_init(s, 0);
+}
+static void hash_state_byte(HashState *s, unsigned char ch)
+{
+	hash64_update_byte(s, ch);
+}
+static void hash_state_update(HashState *s, const void *data, size_t n)
+{
+	hash64_update(s, data, n);
+}
+static uint64_t hash_state_final(HashState *s)
+{
+	return hash64_final(s);
+}
+static uint64_t hash_bytes(const void *data, size_t n)
+{
+	return hash64(data, n);
+}
+static uint64_t hash_bytes_lc(const void *data, size_t n)
+{
+	return hash64_lc(data, n);
+}
+#endif
+
+// Case insensitive equality for ASCII, compares 8 bytes at a time.
+static bool ascii_memieq(const void *a, const void *b, size_t n)
+{
+	const unsigned char *p = (const unsigned char *)a;
+	const unsigned char *q = (const unsigned char *)b;
+	for(; n >= 8; n -= 8, p += 8, q += 8)
+	{
+		if(ascii_tolower64(hash64_read_(p, 8)) != ascii_tolower64(hash64_read_(q, 8)))
+			return false;
+	}
+	return ascii_tolower64(hash64_read_(p, n)) == ascii_tolower64(hash64_read_(q, n));
+}
+
+// Case insensitive equality of two zero terminated ASCII strings.
+static bool ascii_strieq(const char *a, const char *b)
+{
+	for(;; ++a, ++b)
+	{
+		if(ascii_tolower(*a) != ascii_tolower(*b))
+			return false;
+		if(!*a)
+			return true;
+	}
+}
+
 static void print_hex_string(char *data, size_t n)
 {
 	for(size_t i = 0; i < n; ++i)
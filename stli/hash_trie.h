@@ -21,23 +21,31 @@ struct HashTrieNode
 	const char *key;
 	void *value;
 	HashTrieNode *next;
+	uint64_t hash; // Full hash of key, checked before key is touched
+	size_t length;
+	HashTrieNode **prev; // The next (or head) that points at this node, for unlinking on removal
 };
 
 typedef struct
 {
-	HashTrieNode *head;
+	HashTrieNode *root;
+	HashTrieNode *head; // Insertion order, linked through next
 	HashTrieNode **tail;
 } HashTrie;
 
-static const char *hash_trie_dup_str_(Allocator *a, const char *str)
+static const char *hash_trie_dup_range_(Allocator *a, const char *str, size_t n)
 {
-	size_t n = strlen(str);
 	char *newstr = (char*)a->malloc(a->ctx, n + 1);
 	memcpy(newstr, str, n);
 	newstr[n] = 0;
 	return newstr;
 }
 
+static const char *hash_trie_dup_str_(Allocator *a, const char *str)
+{
+	return hash_trie_dup_range_(a, str, strlen(str));
+}
+
 // https://github.com/skeeto/scratch/blob/master/misc/rainbow.c
 // static uint64_t permute64(uint64_t x)
 // {
@@ -48,6 +56,7 @@ static const char *hash_trie_dup_str_(Allocator *a, const char *str)
 
 static void hash_trie_init(HashTrie *trie)
 {
+	trie->root = NULL;
 	trie->head = NULL;
 	trie->tail = &trie->head;
 }
@@ -75,18 +84,29 @@ static void hash_trie_init(HashTrie *trie)
 // printf("}\n");
 
 // After trying FNV, it seemed to perform worse
+// Uses the shared hash from stli/hash.h so keys hash the same as lexer tokens, case insensitive keys are hashed as if
+// they were lowercase.
 
-#include <ctype.h>
+#include <stli/hash.h>
 
 static uint64_t hash_trie_hash_func_(const char *s, bool case_sensitive)
 {
-	uint64_t h = 0x100;
-	for(ptrdiff_t i = 0; s[i]; i++)
-	{
-		h ^= case_sensitive ? s[i] : tolower(s[i]);
-		h *= 1111111111111111111u;
-	}
-	return h;
+	size_t n = strlen(s);
+	return case_sensitive ? hash_bytes(s, n) : hash_bytes_lc(s, n);
+}
+
+// The hash the _n functions expect for a key, for case sensitive keys this is the same as Token::hash.
+static uint64_t hash_trie_hash(const char *key, size_t length, bool case_sensitive)
+{
+	return case_sensitive ? hash_bytes(key, length) : hash_bytes_lc(key, length);
+}
+
+// Only reads the key bytes of a node once its full hash and length match, which is almost always a real match.
+static bool hash_trie_node_eq_(HashTrieNode *node, const char *key, size_t length, uint64_t hash, bool case_sensitive)
+{
+	if(node->hash != hash || node->length != length)
+		return false;
+	return case_sensitive ? !memcmp(node->key, key, length) : ascii_memieq(node->key, key, length);
 }
 
 // If no arena is provided, it reverts to a lookup and returns null when the key is not found. It allows one function to
@@ -97,12 +117,40 @@ static uint64_t hash_trie_hash_func_(const char *s, bool case_sensitive)
 	#define stricmp strcasecmp
 #endif
 
-static HashTrieNode *hash_trie_upsert(HashTrie *trie, const char *key, /*void *initial_value,*/ Allocator *a, bool case_sensitive)
+static HashTrieNode *hash_trie_new_node_(Allocator *a, const char *key, size_t length, uint64_t hash)
 {
-	HashTrieNode **m = &trie->head;
-	int (*cmp)(const char *, const char *);
-	cmp = case_sensitive ? strcmp : stricmp;
-	for(uint64_t h = hash_trie_hash_func_(key, case_sensitive);; h <<= HASH_TRIE_ARY)
+	// HashTrieNode *new_node = new(a, HashTrieNode, 1);
+	HashTrieNode *new_node = (HashTrieNode*)a->malloc(a->ctx, sizeof(HashTrieNode));
+	if(!(a->flags & ALLOCATOR_FLAG_ZEROED))
+		memset(new_node, 0, sizeof(HashTrieNode));
+	new_node->key = hash_trie_dup_range_(a, key, length);
+	new_node->hash = hash;
+	new_node->length = length;
+	// new_node->next = 0;
+	// new_node->value = initial_value;
+	return new_node;
+}
+
+static HashTrieNode *hash_trie_insert_(HashTrie *trie, HashTrieNode **m, const char *key, size_t length, uint64_t hash, Allocator *a)
+{
+	if(!trie->tail)
+	{
+		hash_trie_init(trie);
+	}
+	HashTrieNode *new_node = hash_trie_new_node_(a, key, length, hash);
+	*m = new_node;
+	new_node->prev = trie->tail;
+	*trie->tail = new_node;
+	trie->tail = &new_node->next;
+	return new_node;
+}
+
+// Case insensitive mode, ASCII letters are folded a word at a time for both hashing and comparing.
+// hash has to be hash_trie_hash(key, length, false).
+static HashTrieNode *hash_trie_upsert_ci_n(HashTrie *trie, const char *key, size_t length, uint64_t hash, Allocator *a)
+{
+	HashTrieNode **m = &trie->root;
+	for(uint64_t h = hash;; h <<= HASH_TRIE_ARY)
 	{
 		if(!*m)
 		{
@@ -110,26 +158,9 @@ static HashTrieNode *hash_trie_upsert(HashTrie *trie, const char *key, /*void *i
 			{
 				return NULL;
 			}
-            
-            if(!trie->tail)
-            {
-                hash_trie_init(trie);
-            }
-
-			// HashTrieNode *new_node = new(a, HashTrieNode, 1);
-			HashTrieNode *new_node = (HashTrieNode*)a->malloc(a->ctx, sizeof(HashTrieNode));
-			memset(new_node, 0, sizeof(HashTrieNode));
-			// memset(new_node, 0, sizeof(HashTrieNode));
-			new_node->key = hash_trie_dup_str_(a, key);
-			// new_node->next = 0;
-			// new_node->value = initial_value;
-
-			*m = new_node;
-			*trie->tail = new_node;
-			trie->tail = &new_node->next;
-			return new_node;
+			return hash_trie_insert_(trie, m, key, length, hash, a);
 		}
-		if(!cmp((*m)->key, key))
+		if(hash_trie_node_eq_(*m, key, length, hash, false))
 		{
 			return *m;
 		}
@@ -137,3 +168,228 @@ static HashTrieNode *hash_trie_upsert(HashTrie *trie, const char *key, /*void *i
 	}
 	return NULL;
 }
+
+static HashTrieNode *hash_trie_upsert_ci(HashTrie *trie, const char *key, Allocator *a)
+{
+	size_t length = strlen(key);
+	return hash_trie_upsert_ci_n(trie, key, length, hash_trie_hash(key, length, false), a);
+}
+
+// Same as hash_trie_upsert for a key of length bytes that doesn't need to be zero terminated, with its hash already
+// computed by hash_trie_hash. Looking up a key straight from a source buffer needs no copy and no rehashing.
+static HashTrieNode *hash_trie_upsert_n(HashTrie *trie, const char *key, size_t length, uint64_t hash, Allocator *a, bool case_sensitive)
+{
+	if(!case_sensitive)
+		return hash_trie_upsert_ci_n(trie, key, length, hash, a);
+	HashTrieNode **m = &trie->root;
+	for(uint64_t h = hash;; h <<= HASH_TRIE_ARY)
+	{
+		if(!*m)
+		{
+			if(!a)
+			{
+				return NULL;
+			}
+			return hash_trie_insert_(trie, m, key, length, hash, a);
+		}
+		if(hash_trie_node_eq_(*m, key, length, hash, true))
+		{
+			return *m;
+		}
+		m = &(*m)->child[h >> (64 - HASH_TRIE_ARY)];
+	}
+	return NULL;
+}
+
+static HashTrieNode *hash_trie_upsert(HashTrie *trie, const char *key, /*void *initial_value,*/ Allocator *a, bool case_sensitive)
+{
+	size_t length = strlen(key);
+	return hash_trie_upsert_n(trie, key, length, hash_trie_hash(key, length, case_sensitive), a, case_sensitive);
+}
+
+// Thread-safe version of hash_trie_upsert_n, any number of threads can insert into and look up the same trie at once.
+// The trie has to be initialized with hash_trie_init beforehand and the allocator has to be thread-safe too, e.g.
+// concurrent_arena_allocator. Lookups (a == NULL) never wait on other threads.
+// A node is fully initialized before a CAS publishes it in its child slot, when two threads race for the same slot the
+// loser continues below the winner and keeps its node for the next empty slot. Insertion order is kept by swapping
+// the tail atomically, a thread walking the next list while others insert can stop early at a node whose successor
+// isn't linked yet but never sees a partially initialized node.
+static HashTrieNode *hash_trie_upsert_concurrent_n(HashTrie *trie, const char *key, size_t length, uint64_t hash, Allocator *a, bool case_sensitive)
+{
+	HashTrieNode **m = &trie->root;
+	HashTrieNode *new_node = NULL;
+	for(uint64_t h = hash;; h <<= HASH_TRIE_ARY)
+	{
+		HashTrieNode *n = __atomic_load_n(m, __ATOMIC_ACQUIRE);
+		if(!n)
+		{
+			if(!a)
+			{
+				return NULL;
+			}
+			if(!new_node)
+			{
+				new_node = hash_trie_new_node_(a, key, length, hash);
+			}
+			if(__atomic_compare_exchange_n(m, &n, new_node, false, __ATOMIC_RELEASE, __ATOMIC_ACQUIRE))
+			{
+				HashTrieNode **prev = __atomic_exchange_n(&trie->tail, &new_node->next, __ATOMIC_ACQ_REL);
+				new_node->prev = prev;
+				__atomic_store_n(prev, new_node, __ATOMIC_RELEASE);
+				return new_node;
+			}
+			// Lost the race, n is now the node that won
+		}
+		if(hash_trie_node_eq_(n, key, length, hash, case_sensitive))
+		{
+			if(new_node)
+			{
+				a->free(a->ctx, (void *)new_node->key);
+				a->free(a->ctx, new_node);
+			}
+			return n;
+		}
+		m = &n->child[h >> (64 - HASH_TRIE_ARY)];
+	}
+	return NULL;
+}
+
+static HashTrieNode *hash_trie_upsert_concurrent(HashTrie *trie, const char *key, Allocator *a, bool case_sensitive)
+{
+	size_t length = strlen(key);
+	return hash_trie_upsert_concurrent_n(trie, key, length, hash_trie_hash(key, length, case_sensitive), a, case_sensitive);
+}
+
+// Removes key from the trie and returns true if it was there, *value (if not NULL) is set to the removed value.
+// The node's place is taken by a leaf from its own subtree, which keeps every other key reachable while the trie
+// only ever gets shallower. The node and its key are returned to a, or left alone if a is NULL (e.g. an arena that
+// is freed all at once). Any pointer to the removed node is invalid afterwards.
+// Not thread-safe, not even with hash_trie_upsert_concurrent_n.
+static bool hash_trie_remove_n(HashTrie *trie, const char *key, size_t length, uint64_t hash, Allocator *a, bool case_sensitive, void **value)
+{
+	HashTrieNode **m = &trie->root;
+	for(uint64_t h = hash;; h <<= HASH_TRIE_ARY)
+	{
+		if(!*m)
+			return false;
+		if(hash_trie_node_eq_(*m, key, length, hash, case_sensitive))
+			break;
+		m = &(*m)->child[h >> (64 - HASH_TRIE_ARY)];
+	}
+	HashTrieNode *node = *m;
+
+	// Any leaf below node will do, take the first one found
+	HashTrieNode **leaf = m;
+	for(;;)
+	{
+		HashTrieNode **child = NULL;
+		for(size_t i = 0; i < (1 << HASH_TRIE_ARY) && !child; ++i)
+		{
+			if((*leaf)->child[i])
+				child = &(*leaf)->child[i];
+		}
+		if(!child)
+			break;
+		leaf = child;
+	}
+	if(leaf == m)
+	{
+		*m = NULL;
+	}
+	else
+	{
+		HashTrieNode *replacement = *leaf;
+		*leaf = NULL;
+		memcpy(replacement->child, node->child, sizeof(node->child));
+		*m = replacement;
+	}
+
+	*node->prev = node->next;
+	if(node->next)
+		node->next->prev = node->prev;
+	else
+		trie->tail = node->prev;
+
+	if(value)
+		*value = node->value;
+	if(a)
+	{
+		a->free(a->ctx, (void *)node->key);
+		a->free(a->ctx, node);
+	}
+	return true;
+}
+
+static bool hash_trie_remove(HashTrie *trie, const char *key, Allocator *a, bool case_sensitive, void **value)
+{
+	size_t length = strlen(key);
+	return hash_trie_remove_n(trie, key, length, hash_trie_hash(key, length, case_sensitive), a, case_sensitive, value);
+}
+
+// Shape of a trie, to catch key sets that make it degenerate. Depth counts edges from the root, so the root is at 0.
+// Nodes deeper than HASH_TRIE_STATS_LEVELS - 1 are counted in the last level.
+#define HASH_TRIE_STATS_LEVELS (64)
+
+typedef struct
+{
+	size_t nodes;
+	size_t max_depth;
+	double mean_depth;
+	size_t level_nodes[HASH_TRIE_STATS_LEVELS];
+	size_t level_children[HASH_TRIE_STATS_LEVELS]; // Child slots in use, out of level_nodes * slots
+	size_t slots; // Child slots per node
+	size_t key_bytes; // Copies of the keys the trie stores itself, including terminators
+	size_t total_bytes; // Nodes and keys
+} HashTrieStats;
+
+static void hash_trie_stats_level_(HashTrieStats *stats, size_t depth, size_t children)
+{
+	size_t level = depth < HASH_TRIE_STATS_LEVELS ? depth : HASH_TRIE_STATS_LEVELS - 1;
+	stats->nodes++;
+	stats->level_nodes[level]++;
+	stats->level_children[level] += children;
+	stats->mean_depth += depth; // Divided by the node count at the end
+	if(depth > stats->max_depth)
+		stats->max_depth = depth;
+}
+
+static void hash_trie_stats_node_(HashTrieStats *stats, HashTrieNode *node, size_t depth)
+{
+	size_t children = 0;
+	for(size_t i = 0; i < stats->slots; ++i)
+	{
+		if(node->child[i])
+		{
+			children++;
+			hash_trie_stats_node_(stats, node->child[i], depth + 1);
+		}
+	}
+	hash_trie_stats_level_(stats, depth, children);
+	stats->key_bytes += node->length + 1;
+}
+
+// Walks the whole trie, not thread-safe.
+static void hash_trie_stats(HashTrie *trie, HashTrieStats *stats)
+{
+	memset(stats, 0, sizeof(HashTrieStats));
+	stats->slots = 1 << HASH_TRIE_ARY;
+	if(trie->root)
+		hash_trie_stats_node_(stats, trie->root, 0);
+	if(stats->nodes)
+		stats->mean_depth /= stats->nodes;
+	stats->total_bytes = stats->nodes * sizeof(HashTrieNode) + stats->key_bytes;
+}
+
+static void hash_trie_stats_print(HashTrieStats *stats, FILE *out)
+{
+	fprintf(out, "nodes: %zu, max depth: %zu, mean depth: %.2f\n", stats->nodes, stats->max_depth, stats->mean_depth);
+	fprintf(out, "key bytes: %zu, total bytes: %zu\n", stats->key_bytes, stats->total_bytes);
+	for(size_t i = 0; i < HASH_TRIE_STATS_LEVELS; ++i)
+	{
+		if(!stats->level_nodes[i])
+			continue;
+		size_t slots = stats->level_nodes[i] * stats->slots;
+		fprintf(out, "\tlevel %zu: %zu nodes, %zu/%zu child slots (%.1f%%)\n", i, stats->level_nodes[i],
+				stats->level_children[i], slots, 100.0 * stats->level_children[i] / slots);
+	}
+}
@@ -0,0 +1,122 @@
+#pragma once
+#include <stdint.h>
+#include <string.h>
+#include <stdbool.h>
+
+#include <stli/allocator.h>
+#include <stli/hash_trie.h>
+
+// Read-only copy of a HashTrie laid out for lookups, for tries that stop changing once they're loaded.
+// Everything lives in one allocation: an open addressing table of slots, the entries in insertion order and all keys
+// packed back to back. A slot holds the entry index and the upper half of the hash, so a lookup touches one slot line
+// and one entry line, the key bytes are only read once the full hash and length match.
+
+typedef struct
+{
+	const char *key; // Points into the packed keys, zero terminated
+	void *value;
+	uint64_t hash;
+	size_t length;
+} FrozenHashTrieEntry;
+
+typedef struct
+{
+	uint32_t index; // Entry index + 1, 0 for an empty slot
+	uint32_t tag; // hash >> 32
+} FrozenHashTrieSlot;
+
+typedef struct
+{
+	FrozenHashTrieSlot *slots;
+	FrozenHashTrieEntry *entries; // Insertion order of the trie
+	size_t count;
+	size_t mask; // Number of slots - 1
+} FrozenHashTrie;
+
+// Copies every key and value of trie, the trie itself is left untouched and can be freed afterwards.
+// The values are copied as is, so anything they point to has to outlive the frozen trie.
+// Returns false if the allocation fails or the trie has more keys than a slot can index.
+static bool hash_trie_freeze(FrozenHashTrie *ft, HashTrie *trie, Allocator *a)
+{
+	memset(ft, 0, sizeof(FrozenHashTrie));
+	size_t count = 0;
+	size_t key_bytes = 0;
+	for(HashTrieNode *it = trie->head; it; it = it->next)
+	{
+		count++;
+		key_bytes += it->length + 1;
+	}
+	if(count >= UINT32_MAX)
+		return false;
+
+	// Keep the load factor at or below 1/2 so probe sequences stay short
+	size_t nslots = 2;
+	while(nslots < count * 2)
+		nslots *= 2;
+
+	size_t size = nslots * sizeof(FrozenHashTrieSlot) + count * sizeof(FrozenHashTrieEntry) + key_bytes;
+	char *p = (char *)a->malloc(a->ctx, size);
+	if(!p)
+		return false;
+	ft->slots = (FrozenHashTrieSlot *)p;
+	ft->entries = (FrozenHashTrieEntry *)(ft->slots + nslots);
+	ft->count = count;
+	ft->mask = nslots - 1;
+	memset(ft->slots, 0, nslots * sizeof(FrozenHashTrieSlot));
+
+	char *keys = (char *)(ft->entries + count);
+	size_t i = 0;
+	for(HashTrieNode *it = trie->head; it; it = it->next, ++i)
+	{
+		FrozenHashTrieEntry *e = &ft->entries[i];
+		memcpy(keys, it->key, it->length + 1);
+		e->key = keys;
+		e->value = it->value;
+		e->hash = it->hash;
+		e->length = it->length;
+		keys += it->length + 1;
+
+		size_t k = it->hash & ft->mask;
+		while(ft->slots[k].index)
+			k = (k + 1) & ft->mask;
+		ft->slots[k].index = i + 1;
+		ft->slots[k].tag = it->hash >> 32;
+	}
+	return true;
+}
+
+static void frozen_hash_trie_free(FrozenHashTrie *ft, Allocator *a)
+{
+	if(ft->slots)
+		a->free(a->ctx, ft->slots);
+	memset(ft, 0, sizeof(FrozenHashTrie));
+}
+
+// Same as hash_trie_upsert_n with a NULL allocator, hash has to be hash_trie_hash(key, length, case_sensitive) and
+// case_sensitive has to match how the keys were inserted into the trie.
+static FrozenHashTrieEntry *frozen_hash_trie_lookup_n(FrozenHashTrie *ft, const char *key, size_t length, uint64_t hash, bool case_sensitive)
+{
+	if(!ft->count)
+		return NULL;
+	uint32_t tag = hash >> 32;
+	for(size_t k = hash & ft->mask;; k = (k + 1) & ft->mask)
+	{
+		FrozenHashTrieSlot *slot = &ft->slots[k];
+		if(!slot->index)
+			return NULL;
+		if(slot->tag != tag)
+			continue;
+		FrozenHashTrieEntry *e = &ft->entries[slot->index - 1];
+		if(e->hash != hash || e->length != length)
+			continue;
+		if(case_sensitive ? !memcmp(e->key, key, length) : ascii_memieq(e->key, key, length))
+			return e;
+	}
+	return NULL;
+}
+
+static FrozenHashTrieEntry *frozen_hash_trie_lookup(FrozenHashTrie *ft, const char *key, bool case_sensitive)
+{
+	size_t length = strlen(key);
+	return frozen_hash_trie_lookup_n(ft, key, length, hash_trie_hash(key, length, case_sensitive), case_sensitive);
+}
@@ -0,0 +1,262 @@
+#pragma once
+#include <stdint.h>
+#include <string.h>
+#include <stdbool.h>
+
+#include <stli/allocator.h>
+#include <stli/hash.h>
+#include <stli/hash_trie.h>
+#include <stli/stream.h>
+
+// On-disk form of a HashTrie that can be mapped into memory and searched in place, nothing is deserialized at load.
+// All links are 32-bit byte offsets from the start of the image, so it works at any address. Nodes are stored in
+// insertion order with the keys packed after them, values are 64-bit integers chosen by the writer.
+//
+// hash_trie_image_write(&trie, &stream, false, asset_handle_of, NULL, &allocator);
+// ...
+// HashTrieImage img;
+// if(!hash_trie_image_open(&img, "assets.trie"))
+//     node = hash_trie_image_lookup(&img, "textures/wall.png");
+//
+// An image is only readable by a build with the same hash function (HASH_BYTES_ID), HASH_TRIE_ARY and byte order,
+// anything else is rejected when opened.
+
+#ifdef _WIN32
+	#include <windows.h>
+#else
+	#include <sys/mman.h>
+	#include <sys/stat.h>
+	#include <fcntl.h>
+	#include <unistd.h>
+#endif
+
+#define HASH_TRIE_IMAGE_MAGIC "STLITRIE"
+#define HASH_TRIE_IMAGE_VERSION (1)
+#define HASH_TRIE_IMAGE_ENDIAN (0x01020304)
+
+enum
+{
+	HASH_TRIE_IMAGE_FLAG_NONE = 0,
+	HASH_TRIE_IMAGE_FLAG_CASE_SENSITIVE = 1
+};
+
+typedef struct
+{
+	char magic[8];
+	uint32_t version;
+	uint32_t endian; // HASH_TRIE_IMAGE_ENDIAN as the writer stored it
+	uint32_t hash_id; // HASH_BYTES_ID
+	uint32_t ary; // HASH_TRIE_ARY
+	uint32_t flags;
+	uint32_t count;
+	uint32_t root; // Offset of the root node, 0 if empty
+	uint32_t nodes; // Offset of the first node
+	uint32_t keys; // Offset of the packed keys
+	uint32_t size; // Size of the whole image
+} HashTrieImageHeader;
+
+typedef struct
+{
+	uint32_t child[1 << HASH_TRIE_ARY]; // Node offsets, 0 if empty
+	uint32_t key; // Offset of the zero terminated key
+	uint32_t length;
+	uint64_t hash;
+	uint64_t value;
+} HashTrieImageNode;
+
+typedef struct
+{
+	const char *base;
+	size_t size;
+	const HashTrieImageHeader *header;
+
+	// Set by hash_trie_image_open
+	bool mapped;
+#ifdef _WIN32
+	HANDLE file;
+	HANDLE mapping;
+#endif
+} HashTrieImage;
+
+// Writes trie to s, returns zero if successful. case_sensitive has to match how the keys were inserted.
+// value converts a node's value to what gets stored, when NULL the value pointer is stored as an integer.
+// The image is put together in memory first, which takes an allocation the size of the image.
+static int hash_trie_image_write(HashTrie *trie, Stream *s, bool case_sensitive,
+								 uint64_t (*value)(void *ctx, HashTrieNode *node), void *ctx, Allocator *a)
+{
+	size_t count = 0;
+	size_t key_bytes = 0;
+	for(HashTrieNode *it = trie->head; it; it = it->next)
+	{
+		count++;
+		key_bytes += it->length + 1;
+	}
+	size_t nodes = sizeof(HashTrieImageHeader);
+	size_t keys = nodes + count * sizeof(HashTrieImageNode);
+	size_t size = (keys + key_bytes + 7) & ~(size_t)7;
+	if(size > UINT32_MAX)
+		return 1;
+	char *image = (char *)a->malloc(a->ctx, size);
+	if(!image)
+		return 1;
+	memset(image, 0, size);
+
+	HashTrieImageHeader *hdr = (HashTrieImageHeader *)image;
+	memcpy(hdr->magic, HASH_TRIE_IMAGE_MAGIC, sizeof(hdr->magic));
+	hdr->version = HASH_TRIE_IMAGE_VERSION;
+	hdr->endian = HASH_TRIE_IMAGE_ENDIAN;
+	hdr->hash_id = HASH_BYTES_ID;
+	hdr->ary = HASH_TRIE_ARY;
+	hdr->flags = case_sensitive ? HASH_TRIE_IMAGE_FLAG_CASE_SENSITIVE : HASH_TRIE_IMAGE_FLAG_NONE;
+	hdr->count = count;
+	hdr->nodes = nodes;
+	hdr->keys = keys;
+	hdr->size = size;
+
+	// Inserting the nodes in their original order with the same descent recreates the shape of the trie
+	size_t key = keys;
+	size_t offset = nodes;
+	for(HashTrieNode *it = trie->head; it; it = it->next, offset += sizeof(HashTrieImageNode))
+	{
+		HashTrieImageNode *node = (HashTrieImageNode *)(image + offset);
+		memcpy(image + key, it->key, it->length + 1);
+		node->key = key;
+		node->length = it->length;
+		node->hash = it->hash;
+		node->value = value ? value(ctx, it) : (uintptr_t)it->value;
+		key += it->length + 1;
+
+		uint32_t *m = &hdr->root;
+		for(uint64_t h = it->hash; *m; h <<= HASH_TRIE_ARY)
+			m = &((HashTrieImageNode *)(image + *m))->child[h >> (64 - HASH_TRIE_ARY)];
+		*m = offset;
+	}
+
+	size_t written = s->write(s, image, 1, size);
+	a->free(a->ctx, image);
+	return written == size ? 0 : 1;
+}
+
+// Uses an image already in memory, data has to be 8 byte aligned and outlive img. Returns zero if successful.
+static int hash_trie_image_open_memory(HashTrieImage *img, const void *data, size_t size)
+{
+	memset(img, 0, sizeof(HashTrieImage));
+	const HashTrieImageHeader *hdr = (const HashTrieImageHeader *)data;
+	if(!data || ((uintptr_t)data & 7) || size < sizeof(HashTrieImageHeader))
+		return 1;
+	if(memcmp(hdr->magic, HASH_TRIE_IMAGE_MAGIC, sizeof(hdr->magic)) || hdr->version != HASH_TRIE_IMAGE_VERSION)
+		return 1;
+	if(hdr->endian != HASH_TRIE_IMAGE_ENDIAN || hdr->hash_id != HASH_BYTES_ID || hdr->ary != HASH_TRIE_ARY)
+		return 1;
+	if(hdr->size != size || hdr->nodes < sizeof(HashTrieImageHeader) || hdr->keys < hdr->nodes || hdr->keys > size ||
+	   (hdr->keys - hdr->nodes) / sizeof(HashTrieImageNode) < hdr->count)
+		return 1;
+	img->base = (const char *)data;
+	img->size = size;
+	img->header = hdr;
+	return 0;
+}
+
+// Maps the file at path read-only, returns zero if successful.
+static int hash_trie_image_open(HashTrieImage *img, const char *path)
+{
+	memset(img, 0, sizeof(HashTrieImage));
+#ifdef _WIN32
+	HANDLE file = CreateFileA(path, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+	if(file == INVALID_HANDLE_VALUE)
+		return 1;
+	LARGE_INTEGER size;
+	HANDLE mapping = NULL;
+	void *p = NULL;
+	if(GetFileSizeEx(file, &size) && size.QuadPart > 0)
+		mapping = CreateFileMappingA(file, NULL, PAGE_READONLY, 0, 0, NULL);
+	if(mapping)
+		p = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+	if(!p || hash_trie_image_open_memory(img, p, size.QuadPart))
+	{
+		if(p)
+			UnmapViewOfFile(p);
+		if(mapping)
+			CloseHandle(mapping);
+		CloseHandle(file);
+		return 1;
+	}
+	img->file = file;
+	img->mapping = mapping;
+#else
+	int fd = open(path, O_RDONLY);
+	if(fd == -1)
+		return 1;
+	struct stat st;
+	void *p = MAP_FAILED;
+	if(!fstat(fd, &st) && st.st_size > 0)
+		p = mmap(NULL, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+	close(fd);
+	if(p == MAP_FAILED)
+		return 1;
+	if(hash_trie_image_open_memory(img, p, st.st_size))
+	{
+		munmap(p, st.st_size);
+		return 1;
+	}
+#endif
+	img->mapped = true;
+	return 0;
+}
+
+static void hash_trie_image_close(HashTrieImage *img)
+{
+	if(img->mapped)
+	{
+#ifdef _WIN32
+		UnmapViewOfFile(img->base);
+		CloseHandle(img->mapping);
+		CloseHandle(img->file);
+#else
+		munmap((void *)img->base, img->size);
+#endif
+	}
+	memset(img, 0, sizeof(HashTrieImage));
+}
+
+// Nodes in insertion order, i < img->header->count.
+static const HashTrieImageNode *hash_trie_image_node(HashTrieImage *img, size_t i)
+{
+	return (const HashTrieImageNode *)(img->base + img->header->nodes) + i;
+}
+
+static const char *hash_trie_image_key(HashTrieImage *img, const HashTrieImageNode *node)
+{
+	return img->base + node->key;
+}
+
+// hash has to be hash_trie_hash(key, length, case_sensitive) with the case sensitivity the image was written with.
+// Offsets are checked as they're followed, a damaged image gives wrong results but is never read out of bounds.
+static const HashTrieImageNode *hash_trie_image_lookup_n(HashTrieImage *img, const char *key, size_t length, uint64_t hash)
+{
+	bool case_sensitive = img->header->flags & HASH_TRIE_IMAGE_FLAG_CASE_SENSITIVE;
+	uint32_t offset = img->header->root;
+	// No path is longer than the number of nodes, which also stops a cycle in a damaged image
+	size_t depth = 0;
+	for(uint64_t h = hash; offset && depth++ <= img->header->count; h <<= HASH_TRIE_ARY)
+	{
+		if((offset & 7) || offset > img->size - sizeof(HashTrieImageNode))
+			return NULL;
+		const HashTrieImageNode *node = (const HashTrieImageNode *)(img->base + offset);
+		if(node->hash == hash && node->length == length && node->key < img->size && img->size - node->key > length)
+		{
+			const char *k = img->base + node->key;
+			if(case_sensitive ? !memcmp(k, key, length) : ascii_memieq(k, key, length))
+				return node;
+		}
+		offset = node->child[h >> (64 - HASH_TRIE_ARY)];
+	}
+	return NULL;
+}
+
+static const HashTrieImageNode *hash_trie_image_lookup(HashTrieImage *img, const char *key)
+{
+	size_t length = strlen(key);
+	bool case_sensitive = img->header->flags & HASH_TRIE_IMAGE_FLAG_CASE_SENSITIVE;
+	return hash_trie_image_lookup_n(img, key, length, hash_trie_hash(key, length, case_sensitive));
+}
@@ -0,0 +1,101 @@
+#pragma once
+#include <stdint.h>
+#include <string.h>
+#include <stdbool.h>
+
+#include <stli/allocator.h>
+#include <stli/hash.h>
+
+// Generates a hash trie specialized at compile time, as opposed to HashTrie which shares one arity for the whole
+// process, stores values behind a void * and picks case sensitivity at runtime.
+//
+// HASH_TRIE_DEFINE(Name, ValueType, ARY, HASH, EQ) defines
+//     Name, NameNode           The trie and its nodes, the value is stored inline in the node
+//     Name_init(Name *)
+//     Name_hash(key, length)   HASH, the hash Name_upsert_n expects
+//     Name_upsert_n(Name *, key, length, hash, Allocator *)
+//     Name_upsert(Name *, key, Allocator *)
+//     Name_get(Name *, key)    Pointer to the value or NULL
+//
+// ARY is log2 of the fanout, HASH is a uint64_t (const void *, size_t) and EQ a bool (const void *, const void *, size_t).
+// As with hash_trie_upsert, passing a NULL allocator to upsert turns it into a lookup.
+//
+// HASH_TRIE_DEFINE(SymbolTable, int, 3, hash_bytes, hash_trie_memeq)
+// HASH_TRIE_DEFINE_CI(AssetIndex, AssetHandle, 2)
+
+static bool hash_trie_memeq(const void *a, const void *b, size_t n)
+{
+	return !memcmp(a, b, n);
+}
+
+#define HASH_TRIE_DEFINE(NAME, VALUE_TYPE, ARY, HASH, EQ)                                                         \
+	typedef struct NAME##Node NAME##Node;                                                                         \
+	struct NAME##Node                                                                                             \
+	{                                                                                                             \
+		NAME##Node *child[1 << (ARY)];                                                                            \
+		const char *key;                                                                                          \
+		size_t length;                                                                                            \
+		uint64_t hash;                                                                                            \
+		NAME##Node *next;                                                                                         \
+		VALUE_TYPE value;                                                                                         \
+	};                                                                                                            \
+	typedef struct                                                                                                \
+	{                                                                                                             \
+		NAME##Node *root;                                                                                         \
+		NAME##Node *head;                                                                                         \
+		NAME##Node **tail;                                                                                        \
+	} NAME;                                                                                                       \
+	static void NAME##_init(NAME *trie)                                                                           \
+	{                                                                                                             \
+		trie->root = NULL;                                                                                        \
+		trie->head = NULL;                                                                                        \
+		trie->tail = &trie->head;                                                                                 \
+	}                                                                                                             \
+	static uint64_t NAME##_hash(const char *key, size_t length)                                                   \
+	{                                                                                                             \
+		return HASH(key, length);                                                                                 \
+	}                                                                                                             \
+	static NAME##Node *NAME##_upsert_n(NAME *trie, const char *key, size_t length, uint64_t hash, Allocator *a)  \
+	{                                                                                                             \
+		NAME##Node **m = &trie->root;                                                                             \
+		for(uint64_t h = hash;; h <<= (ARY))                                                                      \
+		{                                                                                                         \
+			if(!*m)                                                                                               \
+			{                                                                                                     \
+				if(!a)                                                                                            \
+					return NULL;                                                                                  \
+				if(!trie->tail)                                                                                   \
+					NAME##_init(trie);                                                                            \
+				NAME##Node *node = (NAME##Node *)a->malloc(a->ctx, sizeof(NAME##Node));                           \
+				if(!(a->flags & ALLOCATOR_FLAG_ZEROED))                                                           \
+					memset(node, 0, sizeof(NAME##Node));                                                          \
+				char *k = (char *)a->malloc(a->ctx, length + 1);                                                  \
+				memcpy(k, key, length);                                                                           \
+				k[length] = 0;                                                                                    \
+				node->key = k;                                                                                    \
+				node->length = length;                                                                            \
+				node->hash = hash;                                                                                \
+				*m = node;                                                                                        \
+				*trie->tail = node;                                                                               \
+				trie->tail = &node->next;                                                                         \
+				return node;                                                                                      \
+			}                                                                                                     \
+			if((*m)->hash == hash && (*m)->length == length && EQ((*m)->key, key, length))                        \
+				return *m;                                                                                        \
+			m = &(*m)->child[h >> (64 - (ARY))];                                                                  \
+		}                                                                                                         \
+		return NULL;                                                                                              \
+	}                                                                                                             \
+	static NAME##Node *NAME##_upsert(NAME *trie, const char *key, Allocator *a)                                   \
+	{                                                                                                             \
+		size_t length = strlen(key);                                                                              \
+		return NAME##_upsert_n(trie, key, length, HASH(key, length), a);                                          \
+	}                                                                                                             \
+	static VALUE_TYPE *NAME##_get(NAME *trie, const char *key)                                                    \
+	{                                                                                                             \
+		NAME##Node *node = NAME##_upsert(trie, key, NULL);                                                        \
+		return node ? &node->value : NULL;                                                                        \
+	}
+
+#define HASH_TRIE_DEFINE_CS(NAME, VALUE_TYPE, ARY) HASH_TRIE_DEFINE(NAME, VALUE_TYPE, ARY, hash_bytes, hash_trie_memeq)
+#define HASH_TRIE_DEFINE_CI(NAME, VALUE_TYPE, ARY) HASH_TRIE_DEFINE(NAME, VALUE_TYPE, ARY, hash_bytes_lc, ascii_memieq)
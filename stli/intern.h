@@ -0,0 +1,103 @@
+#pragma once
+#include <stdint.h>
+#include <string.h>
+#include <stdbool.h>
+
+#include <stli/allocator.h>
+#include <stli/hash_trie.h>
+
+// Maps strings to dense integer ids so they can be stored and compared as a Symbol instead of copied and strcmp'd.
+// Every distinct string is copied once into the trie, the id indexes an array of trie nodes so getting the string back
+// is a single load. Ids start at 1, 0 is never handed out and can be used for "no symbol". Case sensitive.
+//
+// Interner in;
+// interner_init(&in, &allocator);
+// Symbol a = intern(&in, "position"), b = intern_n(&in, token_text, token_length);
+// if(a == b) ...
+
+typedef uint32_t Symbol;
+
+typedef struct
+{
+	HashTrie trie; // Node values hold the Symbol
+	HashTrieNode **nodes; // Indexed by Symbol, nodes[0] is unused
+	uint32_t count; // Highest Symbol handed out
+	uint32_t capacity;
+	Allocator *allocator;
+} Interner;
+
+static void interner_init(Interner *in, Allocator *a)
+{
+	memset(in, 0, sizeof(Interner));
+	hash_trie_init(&in->trie);
+	in->allocator = a;
+}
+
+// Frees the id table, the trie nodes and keys are only freed along with the allocator (e.g. an arena).
+static void interner_release(Interner *in)
+{
+	if(in->nodes)
+		in->allocator->free(in->allocator->ctx, in->nodes);
+	in->nodes = NULL;
+	in->count = in->capacity = 0;
+}
+
+// hash has to be hash_trie_hash(str, length, true), which is what the lexer puts in Token::hash.
+// Returns 0 if the string is new and memory runs out.
+static Symbol intern_hashed(Interner *in, const char *str, size_t length, uint64_t hash)
+{
+	HashTrieNode *n = hash_trie_upsert_n(&in->trie, str, length, hash, NULL, true);
+	if(n)
+		return (Symbol)(uintptr_t)n->value;
+	if(in->count + 1 >= in->capacity)
+	{
+		uint32_t capacity = in->capacity ? in->capacity * 2 : 64;
+		HashTrieNode **nodes = (HashTrieNode **)allocator_realloc(
+			in->allocator, in->nodes, in->capacity * sizeof(HashTrieNode *), capacity * sizeof(HashTrieNode *));
+		if(!nodes)
+			return 0;
+		in->nodes = nodes;
+		in->capacity = capacity;
+	}
+	n = hash_trie_upsert_n(&in->trie, str, length, hash, in->allocator, true);
+	if(!n)
+		return 0;
+	Symbol id = ++in->count;
+	n->value = (void *)(uintptr_t)id;
+	in->nodes[id] = n;
+	return id;
+}
+
+static Symbol intern_n(Interner *in, const char *str, size_t length)
+{
+	return intern_hashed(in, str, length, hash_trie_hash(str, length, true));
+}
+
+static Symbol intern(Interner *in, const char *str)
+{
+	return intern_n(in, str, strlen(str));
+}
+
+// Returns 0 if the string was never interned, doesn't allocate.
+static Symbol interner_find_n(Interner *in, const char *str, size_t length)
+{
+	HashTrieNode *n = hash_trie_upsert_n(&in->trie, str, length, hash_trie_hash(str, length, true), NULL, true);
+	return n ? (Symbol)(uintptr_t)n->value : 0;
+}
+
+// Zero terminated, stays valid for as long as the interner's memory does. NULL for 0.
+static const char *interner_string(Interner *in, Symbol id)
+{
+	return id && id <= in->count ? in->nodes[id]->key : NULL;
+}
+
+static size_t interner_length(Interner *in, Symbol id)
+{
+	return id && id <= in->count ? in->nodes[id]->length : 0;
+}
+
+// hash_trie_hash of the string as stored in the trie, so it can go into another case sensitive trie without rehashing.
+static uint64_t interner_hash(Interner *in, Symbol id)
+{
+	return id && id <= in->count ? in->nodes[id]->hash : 0;
+}
@@ -1,6 +1,7 @@
 #pragma once
 
 #include <stli/stream.h>
+#include <stli/hash.h>
 #include <stdarg.h>
 #include <stdint.h>
 #include <stdlib.h>
@@ -168,19 +169,16 @@ LEXER_STATIC void lexer_unget_token(Lexer *l, Token *t)
 
 LEXER_STATIC void lexer_unget(Lexer *l)
 {
-	s64 current = l->stream->tell(l->stream);
-	if(current == 0)
+	// A native unget already refuses to go before the start
+	if(!l->stream->unget && l->stream->tell(l->stream) == 0)
 		return;
-	l->stream->seek(l->stream, current - 1, SEEK_SET);
+	stream_unget(l->stream);
 }
 
 LEXER_STATIC Token *lexer_read_string(Lexer *lexer, Token *t)
 {
-	// https://en.wikipedia.org/wiki/Fowler%E2%80%93Noll%E2%80%93Vo_hash_function
-	u64 prime = 0x00000100000001B3;
-	u64 offset = 0xcbf29ce484222325;
-
-	u64 hash = offset;
+	HashState hash;
+	hash_state_init(&hash);
 
 	t->token_type = TOKEN_TYPE_STRING;
 	// t->position = lexer->stream->tell(lexer->stream);
@@ -201,10 +199,9 @@ LEXER_STATIC Token *lexer_read_string(Lexer *lexer, Token *t)
 		escaped = (!escaped && ch == '\\');
 		++n;
 
-		hash ^= ch;
-		hash *= prime;
+		hash_state_byte(&hash, ch);
 	}
-	t->hash = hash;
+	t->hash = hash_state_final(&hash);
 	t->length = n;
 	return t;
 }
@@ -237,38 +234,46 @@ LEXER_STATIC Token *lexer_read_multiline_comment(Lexer *lexer, TokenType token_t
 
 LEXER_STATIC Token *lexer_read_characters(Lexer *lexer, Token *t, TokenType token_type, int (*cond)(Token *t, u8 ch, int *undo))
 {
-	// https://en.wikipedia.org/wiki/Fowler%E2%80%93Noll%E2%80%93Vo_hash_function
-	u64 prime = 0x00000100000001B3;
-	u64 offset = 0xcbf29ce484222325;
-
-	u64 hash = offset;
+	HashState hash;
+	hash_state_init(&hash);
 
 	t->token_type = token_type;
 	t->position = lexer->stream->tell(lexer->stream);
 	int n = 0;
-	while(1)
+	int done = 0;
+	// Runs over the stream's window when it has one, so the vtable is only hit once per refill
+	while(!done)
 	{
-		u8 ch = lexer_read_and_advance(lexer);
-		if(!ch)
-		{
-			// lexer_error(lexer, "Unexpected EOF");
+		const u8 *p;
+		u8 byte;
+		size_t avail = stream_window_(lexer->stream, &p, &byte);
+		if(!avail)
 			break;
-		}
-		int undo = 0;
-		if(cond(t, ch, &undo))
+		size_t i = 0;
+		size_t used = avail;
+		for(; i < avail; ++i)
 		{
-			if(undo)
+			u8 ch = p[i];
+			if(!ch)
 			{
-				lexer_unget(lexer);
+				// lexer_error(lexer, "Unexpected EOF");
+				used = i + 1;
+				done = 1;
+				break;
+			}
+			int undo = 0;
+			if(cond(t, ch, &undo))
+			{
+				used = undo ? i : i + 1;
+				done = 1;
+				break;
 			}
-			break;
 		}
-		++n;
-
-		hash ^= ch;
-		hash *= prime;
+		hash_state_update(&hash, p, i);
+		n += i;
+		stream_window_used_(lexer->stream, used, avail);
 	}
-	t->hash = hash;
+	t->hash = hash_state_final(&hash);
 	t->length = n;
 	return t;
 }
@@ -333,15 +338,19 @@ LEXER_STATIC int lexer_accept(Lexer *lexer, TokenType tt, Token *t)
 	Token _;
 	if(!t)
 		t = &_;
-	s64 pos = lexer->stream->tell(lexer->stream);
+	s64 pos = stream_mark(lexer->stream);
 	if(lexer_step(lexer, t))
+	{
+		stream_release_mark(lexer->stream);
 		return 1;
+	}
 	if(tt != t->token_type)
 	{
 		// Undo
-		lexer->stream->seek(lexer->stream, pos, SEEK_SET);
+		stream_restore_mark(lexer->stream, pos);
 		return 1;
 	}
+	stream_release_mark(lexer->stream);
 	return 0;
 }
 
@@ -386,7 +395,7 @@ repeat:
 	ch = lexer_read_and_advance(lexer);
 	if(!ch)
 		return 1;
-	t->hash = (0xcbf29ce484222325 ^ ch) * 0x00000100000001B3;
+	t->hash = hash_bytes(&ch, 1);
 	t->token_type = ch;
 	switch(ch)
 	{
@@ -189,15 +189,22 @@ static bool directive_enabled(const char **enabled, const char *name)
     return false;
 }
 
-static bool preprocess(Preprocessor *pre, Stream *in, Stream *out, size_t *numdirectives, const char **enabled_directives)
+static bool preprocess(Preprocessor *pre, Stream *in, Stream *sink, size_t *numdirectives, const char **enabled_directives)
 {
     *numdirectives = 0;
 
+    // Output comes a token at a time, collect it and hand the sink large blocks
+    Stream out_ = {0};
+    StreamWriter writer;
+    init_stream_writer(&out_, &writer, sink, NULL);
+    Stream *out = &out_;
+
 	Lexer l = {0};
     lexer_init(&l, NULL, in);
 	// l.flags |= k_ELexerFlagSkipComments;
     if(setjmp(l.jmp_error))
     {
+        stream_writer_release(&writer);
         return false;
     }
     while(1)
@@ -248,20 +255,21 @@ static bool preprocess(Preprocessor *pre, Stream *in, Stream *out, size_t *numdi
             s64 save = in->tell(in);
             in->seek(in, beg, SEEK_SET);
 			s64 n = cur - beg;
-            if(n >= sizeof(tmp))
+            // Tokens longer than tmp (e.g. block comments) go through in pieces
+            while(n > 0)
             {
-                printf("n(%d) >= sizeof(tmp)\n", n);
-                return false;
+                size_t chunk = n < sizeof(tmp) ? n : sizeof(tmp);
+                if(in->read(in, tmp, 1, chunk) != chunk)
+                {
+                    stream_writer_release(&writer);
+                    return false;
+                }
+                stream_write_text(out, tmp, chunk);
+                n -= chunk;
             }
-            in->read(in, tmp, 1, n);
-
-            out->write(out, tmp, 1, n);
-            u8 zero = 0;
-            out->write(out, &zero, 1, 1);
-            stream_unget(out);
 
             in->seek(in, save, SEEK_SET);
         }
     }
-    return true;
+    return !stream_writer_release(&writer);
 }
\ No newline at end of file
@@ -0,0 +1,150 @@
+#pragma once
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+#include <stli/allocator.h>
+#include <stli/arena.h>
+
+// Size-class free lists on top of an arena. Freed blocks are pushed on the list of their class and handed out again
+// by the next allocation of that class, so a pool stays bounded by its peak usage instead of growing forever.
+// Every block is preceded by a header that remembers its class, that way free doesn't need to know the size.
+
+static const uint32_t pool_size_classes_[] = { 16, 32, 48, 64, 96, 128, 192, 256, 384, 512, 768, 1024, 1536, 2048 };
+#define POOL_SIZE_CLASS_COUNT (sizeof(pool_size_classes_) / sizeof(pool_size_classes_[0]))
+#define POOL_LARGE ((size_t)-1)
+
+typedef struct PoolBlock PoolBlock;
+
+struct PoolBlock
+{
+	PoolBlock *next;
+};
+
+typedef union
+{
+	size_t size_class;
+	max_align_t align_;
+} PoolHeader;
+
+typedef struct
+{
+	Arena *arena;
+	Allocator *large; // Allocations above the largest class, they come from the arena and are never freed when NULL
+	size_t slab_size; // Bytes carved from the arena at once when a free list runs dry
+	PoolBlock *free_list[POOL_SIZE_CLASS_COUNT];
+} Pool;
+
+static void pool_init(Pool *pool, Arena *arena, Allocator *large)
+{
+	memset(pool, 0, sizeof(Pool));
+	pool->arena = arena;
+	pool->large = large;
+	pool->slab_size = 16 * 1024;
+}
+
+static size_t pool_size_class_(size_t size)
+{
+	for(size_t i = 0; i < POOL_SIZE_CLASS_COUNT; ++i)
+	{
+		if(size <= pool_size_classes_[i])
+			return i;
+	}
+	return POOL_LARGE;
+}
+
+static bool pool_refill_(Pool *pool, size_t size_class)
+{
+	ptrdiff_t stride = sizeof(PoolHeader) + pool_size_classes_[size_class];
+	ptrdiff_t n = pool->slab_size / stride;
+	if(n < 1)
+		n = 1;
+	char *slab = (char *)arena_allocate_memory_(pool->arena, stride, _Alignof(PoolHeader), n, ARENA_FLAG_NO_ZERO);
+	if(!slab)
+		return false;
+	for(ptrdiff_t i = n - 1; i >= 0; --i)
+	{
+		PoolHeader *hdr = (PoolHeader *)(slab + i * stride);
+		hdr->size_class = size_class;
+		PoolBlock *block = (PoolBlock *)(hdr + 1);
+		block->next = pool->free_list[size_class];
+		pool->free_list[size_class] = block;
+	}
+	return true;
+}
+
+static void *pool_malloc(Pool *pool, size_t size)
+{
+	size_t size_class = pool_size_class_(size);
+	if(size_class == POOL_LARGE)
+	{
+		if(size > PTRDIFF_MAX - sizeof(PoolHeader))
+			return NULL;
+		PoolHeader *hdr;
+		if(pool->large)
+			hdr = (PoolHeader *)pool->large->malloc(pool->large->ctx, sizeof(PoolHeader) + size);
+		else
+			hdr = (PoolHeader *)arena_allocate_memory_(pool->arena, 1, _Alignof(PoolHeader), sizeof(PoolHeader) + size, ARENA_FLAG_NO_ZERO);
+		if(!hdr)
+			return NULL;
+		hdr->size_class = POOL_LARGE;
+		return hdr + 1;
+	}
+	if(!pool->free_list[size_class] && !pool_refill_(pool, size_class))
+		return NULL;
+	PoolBlock *block = pool->free_list[size_class];
+	pool->free_list[size_class] = block->next;
+	return block;
+}
+
+static void pool_free(Pool *pool, void *ptr)
+{
+	if(!ptr)
+		return;
+	PoolHeader *hdr = (PoolHeader *)ptr - 1;
+	if(hdr->size_class == POOL_LARGE)
+	{
+		if(pool->large)
+			pool->large->free(pool->large->ctx, hdr);
+		return;
+	}
+	PoolBlock *block = (PoolBlock *)ptr;
+	block->next = pool->free_list[hdr->size_class];
+	pool->free_list[hdr->size_class] = block;
+}
+
+static void *pool_realloc(Pool *pool, void *ptr, size_t old_size, size_t new_size)
+{
+	if(ptr)
+	{
+		size_t size_class = ((PoolHeader *)ptr - 1)->size_class;
+		if(size_class != POOL_LARGE && new_size <= pool_size_classes_[size_class])
+			return ptr;
+	}
+	void *p = pool_malloc(pool, new_size);
+	if(!p || !ptr)
+		return p;
+	memcpy(p, ptr, old_size < new_size ? old_size : new_size);
+	pool_free(pool, ptr);
+	return p;
+}
+
+static void *pool_malloc_(void *ctx, size_t size)
+{
+	return pool_malloc((Pool *)ctx, size);
+}
+
+static void pool_free_(void *ctx, void *ptr)
+{
+	pool_free((Pool *)ctx, ptr);
+}
+
+static void *pool_realloc_(void *ctx, void *ptr, size_t old_size, size_t new_size)
+{
+	return pool_realloc((Pool *)ctx, ptr, old_size, new_size);
+}
+
+static Allocator pool_allocator(Pool *pool)
+{
+	return (Allocator) { pool_malloc_, pool_free_, pool, pool_realloc_ };
+}
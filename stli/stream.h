@@ -2,4 +2,7 @@
 
 #include <stli/_stream/stream.h>
 #include <stli/_stream/buffer.h>
-#include <stli/_stream/file.h>
\ No newline at end of file
+#include <stli/_stream/file.h>
+#include <stli/_stream/mmap.h>
+#include <stli/_stream/writer.h>
+#include <stli/_stream/prefetch.h>
\ No newline at end of file
@@ -14,8 +14,13 @@ static int read_file(const char *path, Arena *arena, char **buffer_out, const ch
 	int n = ftell(fp);
 	fseek(fp, 0, SEEK_SET);
 
-	char *buffer = new(arena, char, n);
-	fread(buffer, n, 1, fp);
+	char *buffer = new_uninit(arena, char, n + 1);
+	if(!buffer)
+	{
+		fclose(fp);
+		return 1;
+	}
+	n = fread(buffer, 1, n, fp); // Can be less than the file size in text mode
 	buffer[n] = 0;
 	fclose(fp);
 	*buffer_out = buffer;
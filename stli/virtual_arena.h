@@ -0,0 +1,163 @@
+#pragma once
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include <stli/arena.h>
+
+// Arena backed by a reserved range of address space. Nothing is committed up front, pages are committed as beg
+// advances so the arena can be made as large as the address space allows while only paying for what's used.
+// Since the range never moves, pointers stay valid for the lifetime of the arena.
+
+#ifdef _WIN32
+	#include <windows.h>
+#else
+	#include <sys/mman.h>
+	#include <fcntl.h>
+	#include <unistd.h>
+	// Strict ISO C modes (-std=c11) hide these, the reservation then works without them
+	#ifndef MAP_NORESERVE
+		#define MAP_NORESERVE 0
+	#endif
+#endif
+
+enum
+{
+	VIRTUAL_ARENA_FLAG_NONE = 0,
+	VIRTUAL_ARENA_FLAG_HUGE_PAGES = 1 // Align the reservation to 2 MB and ask for transparent huge pages
+};
+
+#define VIRTUAL_ARENA_HUGE_PAGE_SIZE (2 * 1024 * 1024)
+
+static size_t virtual_arena_page_size_(void)
+{
+#ifdef _WIN32
+	SYSTEM_INFO si;
+	GetSystemInfo(&si);
+	return si.dwPageSize;
+#else
+	return sysconf(_SC_PAGESIZE);
+#endif
+}
+
+static bool virtual_arena_commit_(char *p, size_t size)
+{
+#ifdef _WIN32
+	return VirtualAlloc(p, size, MEM_COMMIT, PAGE_READWRITE) != NULL;
+#else
+	return !mprotect(p, size, PROT_READ | PROT_WRITE);
+#endif
+}
+
+#ifndef _WIN32
+// Inaccessible private mapping, at a fixed address when at isn't NULL. A private mapping of /dev/zero is the POSIX way
+// to get anonymous memory where MAP_ANONYMOUS is missing.
+static char *virtual_arena_map_(char *at, size_t size)
+{
+	int flags = MAP_PRIVATE | MAP_NORESERVE | (at ? MAP_FIXED : 0);
+#ifdef MAP_ANONYMOUS
+	return (char *)mmap(at, size, PROT_NONE, flags | MAP_ANONYMOUS, -1, 0);
+#else
+	int fd = open("/dev/zero", O_RDWR);
+	if(fd == -1)
+		return (char *)MAP_FAILED;
+	char *p = (char *)mmap(at, size, PROT_NONE, flags, fd, 0);
+	close(fd);
+	return p;
+#endif
+}
+#endif
+
+static void virtual_arena_decommit_(char *p, size_t size)
+{
+#ifdef _WIN32
+	VirtualFree(p, size, MEM_DECOMMIT);
+#elif defined(MADV_DONTNEED)
+	madvise(p, size, MADV_DONTNEED);
+	mprotect(p, size, PROT_NONE);
+#else
+	// Mapping fresh pages over the range drops the old ones, only protect them if that fails
+	if(virtual_arena_map_(p, size) == MAP_FAILED)
+		mprotect(p, size, PROT_NONE);
+#endif
+}
+
+static bool arena_grow_virtual_(Arena *a, ptrdiff_t size, ptrdiff_t align)
+{
+	// end is always page aligned, so committing from there keeps the committed range contiguous
+	ptrdiff_t padding = -(uintptr_t)a->beg & (align - 1);
+	ptrdiff_t need = padding + size - (a->end - a->beg);
+	ptrdiff_t available = a->reserve_end - a->end;
+	if(need > available)
+		return false;
+	ptrdiff_t n = need > a->block_size ? need : a->block_size;
+	n = (n + a->block_size - 1) / a->block_size * a->block_size;
+	if(n > available)
+		n = available;
+	if(!virtual_arena_commit_(a->end, n))
+		return false;
+	a->end += n;
+	return true;
+}
+
+// Reserves reserve bytes of address space, returns non-zero on failure.
+static int virtual_arena_init(Arena *a, size_t reserve, int flags)
+{
+	arena_init(a, NULL, 0);
+	size_t page = virtual_arena_page_size_();
+	size_t granularity = flags & VIRTUAL_ARENA_FLAG_HUGE_PAGES ? VIRTUAL_ARENA_HUGE_PAGE_SIZE : 64 * 1024;
+	reserve = (reserve + granularity - 1) / granularity * granularity;
+	char *base;
+#ifdef _WIN32
+	base = (char *)VirtualAlloc(NULL, reserve, MEM_RESERVE, PAGE_NOACCESS);
+	if(!base)
+		return 1;
+#else
+	size_t slack = flags & VIRTUAL_ARENA_FLAG_HUGE_PAGES ? VIRTUAL_ARENA_HUGE_PAGE_SIZE : 0;
+	char *p = virtual_arena_map_(NULL, reserve + slack);
+	if(p == MAP_FAILED)
+		return 1;
+	base = p;
+	if(slack)
+	{
+		// Trim the mapping so it starts on a huge page boundary
+		base = (char *)(((uintptr_t)p + slack - 1) & ~(uintptr_t)(slack - 1));
+		if(base != p)
+			munmap(p, base - p);
+		munmap(base + reserve, p + slack - base);
+	#ifdef MADV_HUGEPAGE
+		madvise(base, reserve, MADV_HUGEPAGE);
+	#endif
+	}
+#endif
+	a->beg = base;
+	a->end = base;
+	a->reserve_beg = base;
+	a->reserve_end = base + reserve;
+	a->block_size = granularity < page ? page : granularity;
+	a->grow = arena_grow_virtual_;
+	return 0;
+}
+
+// Rewinds the arena to the start of the reservation, optionally giving the committed pages back to the OS.
+static void virtual_arena_reset(Arena *a, bool decommit)
+{
+	a->beg = a->reserve_beg;
+	if(decommit && a->end > a->reserve_beg)
+	{
+		virtual_arena_decommit_(a->reserve_beg, a->end - a->reserve_beg);
+		a->end = a->reserve_beg;
+	}
+}
+
+static void virtual_arena_release(Arena *a)
+{
+	if(!a->reserve_beg)
+		return;
+#ifdef _WIN32
+	VirtualFree(a->reserve_beg, 0, MEM_RELEASE);
+#else
+	munmap(a->reserve_beg, a->reserve_end - a->reserve_beg);
+#endif
+	arena_init(a, NULL, 0);
+}